@@ -0,0 +1,231 @@
+#include "capture.h"
+
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+static void convertBgraToRgbaScalar(const uint8_t* source, uint8_t* destination, size_t begin, size_t pixelCount) {
+    for (size_t i = begin; i < pixelCount; i++) {
+        destination[i * 4 + 0] = source[i * 4 + 2];
+        destination[i * 4 + 1] = source[i * 4 + 1];
+        destination[i * 4 + 2] = source[i * 4 + 0];
+        destination[i * 4 + 3] = 255;
+    }
+}
+
+#if defined(SIMD_X86)
+static void convertBgraToRgbaSSE(const uint8_t* source, uint8_t* destination, size_t pixelCount) {
+    size_t end = pixelCount & ~size_t(3);
+    const __m128i greenMask = _mm_set1_epi32(0x0000ff00);
+    const __m128i blueMask = _mm_set1_epi32(0x000000ff);
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xff000000u));
+
+    for (size_t i = 0; i < end; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+        __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), blueMask);
+        __m128i blue = _mm_slli_epi32(_mm_and_si128(pixels, blueMask), 16);
+        __m128i swapped = _mm_or_si128(_mm_or_si128(red, blue), _mm_or_si128(_mm_and_si128(pixels, greenMask), opaque));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), swapped);
+    }
+    convertBgraToRgbaScalar(source, destination, end, pixelCount);
+}
+
+static SIMD_TARGET_AVX2 void convertBgraToRgbaAVX2(const uint8_t* source, uint8_t* destination, size_t pixelCount) {
+    size_t end = pixelCount & ~size_t(7);
+    const __m256i swizzle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+
+    for (size_t i = 0; i < end; i += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, swizzle), opaque));
+    }
+    convertBgraToRgbaScalar(source, destination, end, pixelCount);
+}
+#endif
+
+void convertBgraToRgba(SimdLevel level, const uint8_t* source, uint8_t* destination, size_t pixelCount) {
+#if defined(SIMD_X86)
+    if (level == SimdLevel::AVX2) {
+        convertBgraToRgbaAVX2(source, destination, pixelCount);
+        return;
+    }
+    if (level == SimdLevel::SSE) {
+        convertBgraToRgbaSSE(source, destination, pixelCount);
+        return;
+    }
+#endif
+    convertBgraToRgbaScalar(source, destination, 0, pixelCount);
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> entries(4 * 256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+        for (uint32_t n = 0; n < 256; n++) {
+            for (uint32_t slice = 1; slice < 4; slice++) {
+                uint32_t previous = entries[(slice - 1) * 256 + n];
+                entries[slice * 256 + n] = entries[previous & 0xff] ^ (previous >> 8);
+            }
+        }
+        return entries;
+    }();
+
+    crc = ~crc;
+    for (; size >= 4; data += 4, size -= 4) {
+        crc ^= static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+        crc = table[3 * 256 + (crc & 0xff)] ^ table[2 * 256 + ((crc >> 8) & 0xff)] ^ table[256 + ((crc >> 16) & 0xff)] ^ table[crc >> 24];
+    }
+    for (; size > 0; data++, size--) {
+        crc = table[(crc ^ *data) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t adler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // 5552 is the largest run for which the sums cannot overflow before the modulo.
+        size_t chunk = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < chunk; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += chunk;
+        size -= chunk;
+    }
+    return (b << 16) | a;
+}
+
+static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void appendPngChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data) {
+    appendBigEndian(png, static_cast<uint32_t>(data.size()));
+    size_t typeOffset = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+    appendBigEndian(png, crc32(png.data() + typeOffset, png.size() - typeOffset));
+}
+
+std::vector<uint8_t> encodePng(const uint8_t* rgba, uint32_t width, uint32_t height) {
+    const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<uint8_t> png(signature, signature + sizeof(signature));
+
+    std::vector<uint8_t> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+    appendPngChunk(png, "IHDR", header);
+    appendPngChunk(png, "sRGB", {0});
+
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    size_t rawSize = (rowBytes + 1) * height;
+    std::vector<uint8_t> raw(rawSize);
+    for (uint32_t y = 0; y < height; y++) {
+        raw[y * (rowBytes + 1)] = 0;
+        std::memcpy(&raw[y * (rowBytes + 1) + 1], rgba + y * rowBytes, rowBytes);
+    }
+
+    // The IDAT chunk is written in place rather than through appendPngChunk to avoid another frame-sized copy.
+    size_t blockCount = (rawSize + 65534) / 65535;
+    size_t zlibSize = 2 + rawSize + blockCount * 5 + 4;
+    png.reserve(png.size() + zlibSize + 24);
+    appendBigEndian(png, static_cast<uint32_t>(zlibSize));
+    size_t typeOffset = png.size();
+    png.insert(png.end(), {'I', 'D', 'A', 'T', 0x78, 0x01});
+    for (size_t offset = 0; offset < rawSize;) {
+        size_t blockSize = std::min<size_t>(rawSize - offset, 65535);
+        png.push_back(offset + blockSize == rawSize ? 1 : 0);
+        png.push_back(static_cast<uint8_t>(blockSize));
+        png.push_back(static_cast<uint8_t>(blockSize >> 8));
+        png.push_back(static_cast<uint8_t>(~blockSize));
+        png.push_back(static_cast<uint8_t>(~blockSize >> 8));
+        png.insert(png.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        offset += blockSize;
+    }
+    appendBigEndian(png, adler32(raw.data(), raw.size()));
+    appendBigEndian(png, crc32(png.data() + typeOffset, png.size() - typeOffset));
+
+    appendPngChunk(png, "IEND", {});
+    return png;
+}
+
+bool writePng(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height) {
+    std::vector<uint8_t> png = encodePng(rgba, width, height);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    return static_cast<bool>(file);
+}
+
+static uint32_t readBigEndian(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+bool decodePng(const std::vector<uint8_t>& png, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height) {
+    const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (png.size() < sizeof(signature) || std::memcmp(png.data(), signature, sizeof(signature)) != 0) return false;
+
+    std::vector<uint8_t> zlib;
+    bool hasHeader = false;
+    for (size_t offset = sizeof(signature); offset + 12 <= png.size();) {
+        uint32_t length = readBigEndian(&png[offset]);
+        if (length > png.size() - offset - 12) return false;
+        const uint8_t* type = &png[offset + 4];
+        const uint8_t* data = &png[offset + 8];
+        if (crc32(type, length + 4) != readBigEndian(data + length)) return false;
+
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length != 13 || data[8] != 8 || data[9] != 6 || data[12] != 0) return false;
+            width = readBigEndian(data);
+            height = readBigEndian(data + 4);
+            hasHeader = true;
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            zlib.insert(zlib.end(), data, data + length);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        offset += 12 + length;
+    }
+    if (!hasHeader || zlib.size() < 6) return false;
+
+    std::vector<uint8_t> raw;
+    size_t offset = 2;
+    for (bool last = false; !last;) {
+        if (offset + 5 > zlib.size() || (zlib[offset] & 0x06) != 0) return false;
+        last = (zlib[offset] & 1) != 0;
+        size_t blockSize = zlib[offset + 1] | (zlib[offset + 2] << 8);
+        if (offset + 5 + blockSize > zlib.size()) return false;
+        raw.insert(raw.end(), zlib.begin() + offset + 5, zlib.begin() + offset + 5 + blockSize);
+        offset += 5 + blockSize;
+    }
+    if (offset + 4 > zlib.size() || adler32(raw.data(), raw.size()) != readBigEndian(&zlib[offset])) return false;
+
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    if (raw.size() != (rowBytes + 1) * height) return false;
+    rgba.resize(rowBytes * height);
+    for (uint32_t y = 0; y < height; y++) {
+        if (raw[y * (rowBytes + 1)] != 0) return false;
+        std::memcpy(&rgba[y * rowBytes], &raw[y * (rowBytes + 1) + 1], rowBytes);
+    }
+    return true;
+}
+
+bool readPng(const std::string& path, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> png((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return file.is_open() && decodePng(png, rgba, width, height);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string>
+
+#include "cpu_features.h"
+
+// Swapchain images are usually B8G8R8A8; PNG wants R8G8B8A8. The sRGB encoding is kept as is, since PNG stores
+// sRGB values too. Alpha is forced to opaque because the compositor ignores it.
+void convertBgraToRgba(SimdLevel level, const uint8_t* source, uint8_t* destination, size_t pixelCount);
+
+// Slicing-by-4 CRC-32: four table lookups per 32-bit word instead of one per byte.
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+uint32_t adler32(const uint8_t* data, size_t size);
+
+// Encodes RGBA8 pixels as a PNG using stored (uncompressed) deflate blocks. Capture throughput matters more here than
+// file size, and stored blocks cost little more than a copy.
+std::vector<uint8_t> encodePng(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+bool writePng(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+// Decodes the PNGs encodePng writes: 8-bit RGBA, stored deflate blocks and no row filters. Returns false for anything
+// else, including files from other encoders.
+bool decodePng(const std::vector<uint8_t>& png, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height);
+
+bool readPng(const std::string& path, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height);
@@ -0,0 +1,118 @@
+#include "culling.h"
+
+static size_t appendVisible(uint32_t mask, uint32_t base, uint32_t* visible, size_t count) {
+    while (mask != 0) {
+        visible[count++] = base + countTrailingZeros(mask);
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+// The AABB test only needs the corner furthest along each plane normal, so the min/max column to read is picked
+// once per plane instead of once per object.
+struct PlaneCorners {
+    const float* x[FRUSTUM_PLANE_COUNT];
+    const float* y[FRUSTUM_PLANE_COUNT];
+    const float* z[FRUSTUM_PLANE_COUNT];
+
+    PlaneCorners(const FrustumPlanes& planes, const BoundingVolumes& bounds) {
+        for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+            x[p] = planes.a[p] >= 0.0f ? bounds.maxX.data() : bounds.minX.data();
+            y[p] = planes.b[p] >= 0.0f ? bounds.maxY.data() : bounds.minY.data();
+            z[p] = planes.c[p] >= 0.0f ? bounds.maxZ.data() : bounds.minZ.data();
+        }
+    }
+};
+
+static bool isVisibleScalar(const FrustumPlanes& planes, const PlaneCorners& corners, const BoundingVolumes& bounds, size_t i) {
+    for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+        float sphereDistance = planes.a[p] * bounds.centerX[i] + planes.b[p] * bounds.centerY[i] + planes.c[p] * bounds.centerZ[i] + planes.d[p];
+        float boxDistance = planes.a[p] * corners.x[p][i] + planes.b[p] * corners.y[p][i] + planes.c[p] * corners.z[p][i] + planes.d[p];
+        if (sphereDistance < -bounds.radius[i] || boxDistance < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t cullScalar(const FrustumPlanes& planes, const PlaneCorners& corners, const BoundingVolumes& bounds, size_t begin, uint32_t* visible, size_t count) {
+    for (size_t i = begin; i < bounds.size(); i++) {
+        if (isVisibleScalar(planes, corners, bounds, i)) {
+            visible[count++] = static_cast<uint32_t>(i);
+        }
+    }
+    return count;
+}
+
+#if defined(SIMD_X86)
+static size_t cullSSE(const FrustumPlanes& planes, const PlaneCorners& corners, const BoundingVolumes& bounds, uint32_t* visible) {
+    size_t count = 0;
+    size_t end = bounds.size() & ~size_t(3);
+    for (size_t i = 0; i < end; i += 4) {
+        __m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+            __m128 a = _mm_set1_ps(planes.a[p]);
+            __m128 b = _mm_set1_ps(planes.b[p]);
+            __m128 c = _mm_set1_ps(planes.c[p]);
+            __m128 d = _mm_set1_ps(planes.d[p]);
+
+            __m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, centerX), _mm_mul_ps(b, centerY)), _mm_add_ps(_mm_mul_ps(c, centerZ), d));
+            __m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(corners.x[p] + i)), _mm_mul_ps(b, _mm_loadu_ps(corners.y[p] + i))),
+                _mm_add_ps(_mm_mul_ps(c, _mm_loadu_ps(corners.z[p] + i)), d));
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(sphereDistance, negativeRadius));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(boxDistance, _mm_setzero_ps()));
+        }
+
+        count = appendVisible(static_cast<uint32_t>(_mm_movemask_ps(inside)), static_cast<uint32_t>(i), visible, count);
+    }
+    return cullScalar(planes, corners, bounds, end, visible, count);
+}
+
+static SIMD_TARGET_AVX2 size_t cullAVX2(const FrustumPlanes& planes, const PlaneCorners& corners, const BoundingVolumes& bounds, uint32_t* visible) {
+    size_t count = 0;
+    size_t end = bounds.size() & ~size_t(7);
+    for (size_t i = 0; i < end; i += 8) {
+        __m256 centerX = _mm256_loadu_ps(&bounds.centerX[i]);
+        __m256 centerY = _mm256_loadu_ps(&bounds.centerY[i]);
+        __m256 centerZ = _mm256_loadu_ps(&bounds.centerZ[i]);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+            __m256 a = _mm256_set1_ps(planes.a[p]);
+            __m256 b = _mm256_set1_ps(planes.b[p]);
+            __m256 c = _mm256_set1_ps(planes.c[p]);
+            __m256 d = _mm256_set1_ps(planes.d[p]);
+
+            __m256 sphereDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, centerX), _mm256_mul_ps(b, centerY)), _mm256_add_ps(_mm256_mul_ps(c, centerZ), d));
+            __m256 boxDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, _mm256_loadu_ps(corners.x[p] + i)), _mm256_mul_ps(b, _mm256_loadu_ps(corners.y[p] + i))),
+                _mm256_add_ps(_mm256_mul_ps(c, _mm256_loadu_ps(corners.z[p] + i)), d));
+
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(sphereDistance, negativeRadius, _CMP_GE_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(boxDistance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        count = appendVisible(static_cast<uint32_t>(_mm256_movemask_ps(inside)), static_cast<uint32_t>(i), visible, count);
+    }
+    return cullScalar(planes, corners, bounds, end, visible, count);
+}
+#endif
+
+size_t cullBoundingVolumes(SimdLevel level, const FrustumPlanes& planes, const BoundingVolumes& bounds, uint32_t* visible) {
+    PlaneCorners corners(planes, bounds);
+#if defined(SIMD_X86)
+    if (level == SimdLevel::AVX2) {
+        return cullAVX2(planes, corners, bounds, visible);
+    }
+    if (level == SimdLevel::SSE) {
+        return cullSSE(planes, corners, bounds, visible);
+    }
+#endif
+    return cullScalar(planes, corners, bounds, 0, visible, 0);
+}
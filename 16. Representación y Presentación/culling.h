@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu_features.h"
+
+const uint32_t FRUSTUM_PLANE_COUNT = 6;
+
+// Planes are stored as a*x + b*y + c*z + d >= 0 for points inside the frustum.
+struct FrustumPlanes {
+    float a[FRUSTUM_PLANE_COUNT];
+    float b[FRUSTUM_PLANE_COUNT];
+    float c[FRUSTUM_PLANE_COUNT];
+    float d[FRUSTUM_PLANE_COUNT];
+
+    void setPlane(uint32_t plane, float planeA, float planeB, float planeC, float planeD) {
+        a[plane] = planeA;
+        b[plane] = planeB;
+        c[plane] = planeC;
+        d[plane] = planeD;
+    }
+};
+
+struct BoundingVolumes {
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    void resize(size_t count) {
+        for (std::vector<float>* column : {&centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ}) {
+            column->resize(count);
+        }
+    }
+
+    size_t size() const {
+        return centerX.size();
+    }
+};
+
+// Writes the indices of every volume whose sphere and box both intersect the frustum into visible, which must
+// hold bounds.size() entries, and returns how many were written. Indices come out in ascending order.
+size_t cullBoundingVolumes(SimdLevel level, const FrustumPlanes& planes, const BoundingVolumes& bounds, uint32_t* visible);
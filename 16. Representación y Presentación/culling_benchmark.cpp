@@ -0,0 +1,86 @@
+#include "culling.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+FrustumPlanes createBenchmarkFrustum() {
+    FrustumPlanes planes{};
+    planes.setPlane(0, 1.0f, 0.0f, 0.0f, 1.0f);
+    planes.setPlane(1, -1.0f, 0.0f, 0.0f, 1.0f);
+    planes.setPlane(2, 0.0f, 1.0f, 0.0f, 1.0f);
+    planes.setPlane(3, 0.0f, -1.0f, 0.0f, 1.0f);
+    planes.setPlane(4, 0.0f, 0.0f, 1.0f, 0.0f);
+    planes.setPlane(5, 0.0f, 0.0f, -1.0f, 1.0f);
+    return planes;
+}
+
+BoundingVolumes createBenchmarkBounds(size_t count) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> extent(0.01f, 0.2f);
+
+    BoundingVolumes bounds;
+    bounds.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        float halfExtent = extent(random);
+        bounds.centerX[i] = position(random);
+        bounds.centerY[i] = position(random);
+        bounds.centerZ[i] = position(random) * 0.5f + 0.5f;
+        bounds.radius[i] = halfExtent * 1.7320508f;
+        bounds.minX[i] = bounds.centerX[i] - halfExtent;
+        bounds.minY[i] = bounds.centerY[i] - halfExtent;
+        bounds.minZ[i] = bounds.centerZ[i] - halfExtent;
+        bounds.maxX[i] = bounds.centerX[i] + halfExtent;
+        bounds.maxY[i] = bounds.centerY[i] + halfExtent;
+        bounds.maxZ[i] = bounds.centerZ[i] + halfExtent;
+    }
+    return bounds;
+}
+
+int main() {
+    SimdLevel detected = detectSimdLevel();
+    std::vector<SimdLevel> kernels = {SimdLevel::Scalar};
+    if (detected == SimdLevel::SSE || detected == SimdLevel::AVX2) kernels.push_back(SimdLevel::SSE);
+    if (detected == SimdLevel::AVX2) kernels.push_back(SimdLevel::AVX2);
+
+    std::cout << "detected kernel: " << simdLevelName(detected) << std::endl;
+    std::cout << std::left << std::setw(10) << "objects" << std::setw(8) << "kernel" << std::setw(10) << "visible"
+              << std::setw(14) << "ns/object" << std::setw(16) << "Mobjects/s" << "speedup" << std::endl;
+
+    FrustumPlanes planes = createBenchmarkFrustum();
+    for (size_t count = 1000; count <= 1000000; count *= 10) {
+        BoundingVolumes bounds = createBenchmarkBounds(count);
+        std::vector<uint32_t> reference(count);
+        std::vector<uint32_t> visible(count);
+        size_t referenceCount = cullBoundingVolumes(SimdLevel::Scalar, planes, bounds, reference.data());
+
+        size_t repeats = std::max<size_t>(10, 20000000 / count);
+        double scalarTime = 0.0;
+        for (SimdLevel kernel : kernels) {
+            size_t visibleCount = cullBoundingVolumes(kernel, planes, bounds, visible.data());
+            if (visibleCount != referenceCount || !std::equal(reference.begin(), reference.begin() + referenceCount, visible.begin())) {
+                std::cerr << simdLevelName(kernel) << " kernel disagrees with the scalar kernel at " << count << " objects!" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t repeat = 0; repeat < repeats; repeat++) {
+                visibleCount = cullBoundingVolumes(kernel, planes, bounds, visible.data());
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+            if (kernel == SimdLevel::Scalar) scalarTime = seconds;
+
+            std::cout << std::left << std::setw(10) << count << std::setw(8) << simdLevelName(kernel) << std::setw(10) << visibleCount
+                      << std::setw(14) << std::fixed << std::setprecision(3) << seconds * 1e9 / count
+                      << std::setw(16) << std::setprecision(1) << count / seconds / 1e6
+                      << std::setprecision(2) << scalarTime / seconds << "x" << std::endl;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+#include "capture.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Converts an sRGB pixel to CIE L*a*b* under a D65 white point, so distances approximate perceived differences.
+std::array<double, 3> srgbToLab(const uint8_t* pixel) {
+    double linear[3];
+    for (int i = 0; i < 3; i++) {
+        double c = pixel[i] / 255.0;
+        linear[i] = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+    }
+
+    double xyz[3] = {
+        (0.4124 * linear[0] + 0.3576 * linear[1] + 0.1805 * linear[2]) / 0.95047,
+        0.2126 * linear[0] + 0.7152 * linear[1] + 0.0722 * linear[2],
+        (0.0193 * linear[0] + 0.1192 * linear[1] + 0.9505 * linear[2]) / 1.08883
+    };
+    for (double& t : xyz) {
+        t = t > 216.0 / 24389.0 ? std::cbrt(t) : (24389.0 / 27.0 * t + 16.0) / 116.0;
+    }
+
+    return {116.0 * xyz[1] - 16.0, 500.0 * (xyz[0] - xyz[1]), 200.0 * (xyz[1] - xyz[2])};
+}
+
+// CIE76 colour difference; a delta E around 2.3 is the smallest difference most viewers notice.
+double deltaE(const uint8_t* a, const uint8_t* b) {
+    std::array<double, 3> labA = srgbToLab(a);
+    std::array<double, 3> labB = srgbToLab(b);
+    return std::sqrt((labA[0] - labB[0]) * (labA[0] - labB[0]) + (labA[1] - labB[1]) * (labA[1] - labB[1]) + (labA[2] - labB[2]) * (labA[2] - labB[2]));
+}
+
+// Compares a capture with its golden image and fails when more than MAX_PERCENT of the pixels differ by more than
+// MAX_DELTA_E. On failure DIFF receives the golden image dimmed to grey with the failing pixels in red.
+//   GoldenCompare NAME GOLDEN CAPTURE DIFF MAX_DELTA_E MAX_PERCENT
+int main(int argc, char* argv[]) {
+    if (argc != 7) {
+        std::cerr << "usage: " << argv[0] << " NAME GOLDEN CAPTURE DIFF MAX_DELTA_E MAX_PERCENT" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string name = argv[1];
+    double maxDeltaE = std::stod(argv[5]);
+    double maxPercent = std::stod(argv[6]);
+
+    std::vector<uint8_t> golden, capture;
+    uint32_t goldenWidth = 0, goldenHeight = 0, captureWidth = 0, captureHeight = 0;
+    if (!readPng(argv[2], golden, goldenWidth, goldenHeight)) {
+        std::cerr << name << ": failed to read golden image " << argv[2] << ", render it with make golden-update" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!readPng(argv[3], capture, captureWidth, captureHeight)) {
+        std::cerr << name << ": failed to read capture " << argv[3] << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (goldenWidth != captureWidth || goldenHeight != captureHeight) {
+        std::cerr << name << ": capture is " << captureWidth << "x" << captureHeight << ", golden image is " << goldenWidth << "x" << goldenHeight << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t pixelCount = static_cast<size_t>(goldenWidth) * goldenHeight;
+    std::vector<uint8_t> diff(pixelCount * 4);
+    size_t failing = 0;
+    double worst = 0.0;
+    for (size_t i = 0; i < pixelCount; i++) {
+        double difference = deltaE(&golden[i * 4], &capture[i * 4]);
+        worst = std::max(worst, difference);
+
+        uint8_t grey = static_cast<uint8_t>((golden[i * 4] + golden[i * 4 + 1] + golden[i * 4 + 2]) / 12);
+        diff[i * 4 + 0] = grey;
+        diff[i * 4 + 1] = grey;
+        diff[i * 4 + 2] = grey;
+        diff[i * 4 + 3] = 255;
+        if (difference > maxDeltaE) {
+            failing++;
+            diff[i * 4 + 0] = static_cast<uint8_t>(std::min(255.0, 128.0 + 127.0 * difference / (4.0 * maxDeltaE)));
+            diff[i * 4 + 1] = 0;
+            diff[i * 4 + 2] = 0;
+        }
+    }
+
+    double percent = pixelCount > 0 ? 100.0 * failing / pixelCount : 0.0;
+    bool passed = percent <= maxPercent;
+    std::cout << name << ": " << (passed ? "passed" : "FAILED") << ", " << std::fixed << std::setprecision(3) << percent
+              << "% of pixels above delta E " << std::setprecision(1) << maxDeltaE << " (limit " << std::setprecision(3) << maxPercent
+              << "%), worst delta E " << std::setprecision(1) << worst << std::endl;
+
+    if (!passed) {
+        if (!writePng(argv[4], diff.data(), goldenWidth, goldenHeight)) {
+            std::cerr << name << ": failed to write diff image " << argv[4] << std::endl;
+        } else {
+            std::cout << name << ": diff written to " << argv[4] << std::endl;
+        }
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
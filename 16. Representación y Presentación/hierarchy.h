@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "transforms.h"
+
+const uint32_t NO_PARENT = UINT32_MAX;
+const uint32_t NO_INSTANCE = UINT32_MAX;
+
+// Nodes are stored in depth-first order, so every parent precedes its children and every subtree occupies the
+// contiguous range [node, subtreeEnds[node]). Updating a changed subtree is then one linear pass over that range,
+// and untouched parts of the hierarchy are never visited.
+class TransformHierarchy {
+public:
+    uint32_t addNode(uint32_t parent, const TransformMatrix& local, uint32_t instance = NO_INSTANCE) {
+        uint32_t node = static_cast<uint32_t>(parents.size());
+        if (parent != NO_PARENT && subtreeEnds[parent] != node) {
+            throw std::runtime_error("hierarchy nodes must be added in depth-first order!");
+        }
+
+        parents.push_back(parent);
+        subtreeEnds.push_back(node + 1);
+        instances.push_back(instance);
+        locals.push_back(local);
+        worlds.push_back(local);
+        dirty.push_back(0);
+
+        for (uint32_t ancestor = parent; ancestor != NO_PARENT; ancestor = parents[ancestor]) {
+            subtreeEnds[ancestor] = node + 1;
+        }
+
+        markDirty(node);
+        return node;
+    }
+
+    void setLocal(uint32_t node, const TransformMatrix& local) {
+        locals[node] = local;
+        markDirty(node);
+    }
+
+    const TransformMatrix& getWorld(uint32_t node) const {
+        return worlds[node];
+    }
+
+    uint32_t getInstance(uint32_t node) const {
+        return instances[node];
+    }
+
+    size_t size() const {
+        return parents.size();
+    }
+
+    // Recomputes the world matrix of every dirty node and its descendants, appends the instances whose world
+    // matrix changed to changedInstances, and returns the number of nodes recomputed.
+    size_t update(std::vector<uint32_t>& changedInstances) {
+        std::sort(dirtyNodes.begin(), dirtyNodes.end());
+
+        size_t updated = 0;
+        uint32_t coveredEnd = 0;
+        for (uint32_t dirtyNode : dirtyNodes) {
+            dirty[dirtyNode] = 0;
+            if (dirtyNode < coveredEnd) {
+                continue;
+            }
+
+            coveredEnd = subtreeEnds[dirtyNode];
+            for (uint32_t node = dirtyNode; node < coveredEnd; node++) {
+                worlds[node] = parents[node] == NO_PARENT ? locals[node] : multiplyTransforms(worlds[parents[node]], locals[node]);
+                if (instances[node] != NO_INSTANCE) {
+                    changedInstances.push_back(instances[node]);
+                }
+            }
+            updated += coveredEnd - dirtyNode;
+        }
+
+        dirtyNodes.clear();
+        return updated;
+    }
+
+private:
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> subtreeEnds;
+    std::vector<uint32_t> instances;
+    std::vector<TransformMatrix> locals;
+    std::vector<TransformMatrix> worlds;
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> dirtyNodes;
+
+    void markDirty(uint32_t node) {
+        if (!dirty[node]) {
+            dirty[node] = 1;
+            dirtyNodes.push_back(node);
+        }
+    }
+};
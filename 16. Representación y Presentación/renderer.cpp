@@ -0,0 +1,6550 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <exception>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <set>
+#include <chrono>
+#include <string>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <array>
+#include <numeric>
+#include <random>
+#include <cmath>
+#include <ctime>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+
+#include "renderer.h"
+#include "culling.h"
+#include "transforms.h"
+#include "hierarchy.h"
+#include "capture.h"
+
+const uint32_t WIDTH = 800;
+const uint32_t HEIGHT = 600;
+
+const uint32_t WINDOW_COUNT = 1;
+
+const std::string MODEL_PATH = "models/model.obj";
+
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+// Frame settings are read from FRAME_CONFIG_PATH when it exists, except in --deterministic runs; --auto-tune writes it
+// after benchmarking each candidate for AUTO_TUNE_FRAMES frames.
+const std::string FRAME_CONFIG_PATH = "frame_config.txt";
+const uint64_t AUTO_TUNE_FRAMES = 240;
+
+const VkSampleCountFlagBits MSAA_SAMPLES = VK_SAMPLE_COUNT_4_BIT;
+
+const uint32_t SCENE_OBJECT_COUNT = 16;
+const uint32_t SCENE_GROUP_COUNT = 4;
+const uint32_t ANIMATED_GROUP_COUNT = 1;
+// Objects are flat quads; this is half their depth extent for culling against the near and far planes.
+const float OBJECT_HALF_DEPTH = 0.02f;
+const bool DEPTH_PREPASS = false;
+const bool GPU_DRIVEN_RENDERING = true;
+const uint32_t CULL_WORKGROUP_SIZE = 64;
+// With --calibrate-depth-sort this one frame is drawn back to front, to compare its fragment shader invocations with
+// the front-to-back frame before it.
+const uint64_t DEPTH_SORT_CALIBRATION_FRAME = 120;
+
+// Must match the size of the sampler array in shader.frag.
+const uint32_t TEXTURE_COUNT = 4;
+const uint32_t TEXTURE_SIZE = 1024;
+const VkDeviceSize TEXTURE_BUDGET = 16 * 1024 * 1024;
+
+// A heap is under pressure once its usage passes MEMORY_PRESSURE_THRESHOLD of its budget, and stays so until usage
+// falls back below MEMORY_PRESSURE_RELIEF. Without VK_EXT_memory_budget the budget is MEMORY_FALLBACK_BUDGET of the heap.
+const double MEMORY_PRESSURE_THRESHOLD = 0.9;
+const double MEMORY_PRESSURE_RELIEF = 0.8;
+const double MEMORY_FALLBACK_BUDGET = 0.8;
+const uint32_t MEMORY_BUDGET_POLL_INTERVAL = 30;
+
+// Captures every Nth frame of the first window into CAPTURE_DIRECTORY, or --capture-dir; 0 disables it. F12 captures a single frame.
+const uint64_t CAPTURE_INTERVAL = 0;
+const uint32_t CAPTURE_RING_SIZE = 4;
+const std::string CAPTURE_DIRECTORY = "captures";
+
+// With --on-demand the loop sleeps in glfwWaitEventsTimeout between changes; the timeout only bounds how long an
+// event-less change, such as a finished texture load, can go unnoticed.
+const double ON_DEMAND_WAIT_SECONDS = 0.25;
+
+// How many frame packets the main thread may build ahead of the render thread.
+const uint32_t FRAME_PACKET_QUEUE_SIZE = 2;
+
+// A thread waiting on a full or empty packet queue spins, then yields, then sleeps in short steps.
+const uint32_t PACKET_QUEUE_SPINS = 256;
+const uint32_t PACKET_QUEUE_YIELDS = 64;
+const std::chrono::microseconds PACKET_QUEUE_SLEEP(50);
+
+// Latency is histogrammed in 1 ms buckets; the last bucket collects everything slower.
+const uint32_t LATENCY_HISTOGRAM_BUCKETS = 100;
+const uint64_t PRESENT_WAIT_TIMEOUT = 100000000;
+// With --pace the frame start is pushed later by this much per frame that makes its vblank, and the delay is
+// halved whenever one misses.
+const double PACE_STEP_MILLISECONDS = 0.1;
+
+// Dynamic resolution (--target-gpu-ms) renders into a sub-rectangle of a full-size offscreen target. The scale
+// follows a smoothed GPU frame time, ignores errors inside the dead band and moves at most MAX_STEP per frame.
+const double MIN_RESOLUTION_SCALE = 0.5;
+const double RESOLUTION_SMOOTHING = 0.1;
+const double RESOLUTION_DEAD_BAND = 0.05;
+const double RESOLUTION_MAX_STEP = 0.02;
+
+// --dispatch-benchmark records this many draws per command buffer, keeping the fastest of the repeats.
+const uint32_t DISPATCH_BENCHMARK_DRAWS[] = {1000, 10000, 100000};
+const uint32_t DISPATCH_BENCHMARK_REPEATS = 10;
+
+const std::vector<const char*> validationLayers = {
+    "VK_LAYER_KHRONOS_validation"
+};
+
+const std::vector<const char*> deviceExtensions = {
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME
+};
+
+#ifdef NDEBUG
+const bool enableValidationLayers = false;
+#else
+const bool enableValidationLayers = true;
+#endif
+
+struct QueueFamilyIndices {
+    std::optional<uint32_t> graphicsFamily;
+    std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily;
+
+    bool isComplete() {
+        return graphicsFamily.has_value() && presentFamily.has_value();
+    }
+};
+
+struct SwapChainSupportDetails {
+    VkSurfaceCapabilitiesKHR capabilities;
+    std::vector<VkSurfaceFormatKHR> formats;
+    std::vector<VkPresentModeKHR> presentModes;
+};
+
+struct Vertex {
+    int16_t position[4];
+    int16_t normal[2];
+    uint16_t texCoord[2];
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(Vertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attributeDescriptions[0].offset = offsetof(Vertex, position);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[1].offset = offsetof(Vertex, normal);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+
+        return attributeDescriptions;
+    }
+};
+
+struct SceneObject {
+    float offset[2];
+    float scale;
+    float depth;
+    uint32_t texture;
+    float radius;
+};
+
+struct CullParameters {
+    uint32_t objectCount;
+    uint32_t indexCount;
+    float halfDepth;
+};
+
+struct StreamedTexture {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+
+    std::vector<std::vector<uint8_t>> mipData;
+    std::vector<bool> loadRequested;
+    std::vector<uint64_t> lastUsedFrame;
+    uint32_t desiredMip;
+
+    uint32_t residentMip;
+    VkDeviceSize residentBytes = 0;
+    bool uploadPending = false;
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+};
+
+struct TextureUpload {
+    uint32_t texture;
+    uint32_t baseMip;
+    VkImage image;
+    VkDeviceMemory imageMemory;
+    VkImageView imageView;
+    VkDeviceSize replacedBytes;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkSemaphore semaphore;
+};
+
+enum class CaptureSlotState {
+    Free,
+    Recording,
+    Encoding
+};
+
+struct CaptureSlot {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void* mapped;
+    CaptureSlotState state = CaptureSlotState::Free;
+    size_t frame;
+    uint64_t frameNumber;
+};
+
+struct RenderWindow {
+    GLFWwindow* window;
+    VkSurfaceKHR surface;
+
+    VkSwapchainKHR swapChain;
+    std::vector<VkImage> swapChainImages;
+    VkFormat swapChainImageFormat;
+    VkExtent2D swapChainExtent;
+    bool swapChainTransferSrc = false;
+    bool swapChainTransferDst = false;
+    std::vector<VkImageView> swapChainImageViews;
+    std::vector<VkFramebuffer> swapChainFramebuffers;
+
+    uint32_t swapChainResource;
+    uint32_t colorResource;
+    uint32_t depthResource;
+    uint32_t sceneColorResource;
+
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    uint32_t imageIndex = 0;
+};
+
+class StartupProfiler {
+public:
+    StartupProfiler() : origin(std::chrono::steady_clock::now()) {}
+
+    void begin(const char* name) {
+        Stage stage{};
+        stage.name = name;
+        stage.parent = openStages.empty() ? -1 : openStages.back();
+        stage.start = elapsedMicroseconds();
+        stages.push_back(stage);
+        openStages.push_back(static_cast<int>(stages.size()) - 1);
+    }
+
+    void end() {
+        stages[openStages.back()].end = elapsedMicroseconds();
+        openStages.pop_back();
+    }
+
+    void writeJson(const std::string& filename, const std::string& deviceName) {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open startup profile file!");
+        }
+
+        file << "{\n";
+        file << "  \"build\": \"" << __DATE__ << " " << __TIME__ << "\",\n";
+        file << "  \"device\": \"" << escapeJson(deviceName) << "\",\n";
+        file << "  \"unit\": \"us\",\n";
+        file << "  \"stages\": ";
+        writeChildren(file, -1, 1);
+        file << "\n}\n";
+    }
+
+    void printTree() {
+        printChildren(-1, 0);
+    }
+
+private:
+    struct Stage {
+        std::string name;
+        int parent;
+        double start;
+        double end;
+    };
+
+    std::chrono::steady_clock::time_point origin;
+    std::vector<Stage> stages;
+    std::vector<int> openStages;
+
+    double elapsedMicroseconds() {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    // Device names come from the driver, so quotes, backslashes and control characters must not end the string.
+    static std::string escapeJson(const std::string& text) {
+        std::ostringstream escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+            } else {
+                escaped << c;
+            }
+        }
+        return escaped.str();
+    }
+
+    void writeChildren(std::ofstream& file, int parent, int depth) {
+        std::string indent(depth * 2, ' ');
+        bool first = true;
+
+        file << "[";
+        for (size_t i = 0; i < stages.size(); i++) {
+            if (stages[i].parent != parent) continue;
+
+            file << (first ? "\n" : ",\n") << indent << "  {\"name\": \"" << escapeJson(stages[i].name) << "\", ";
+            file << "\"start\": " << stages[i].start << ", ";
+            file << "\"duration\": " << stages[i].end - stages[i].start << ", ";
+            file << "\"children\": ";
+            writeChildren(file, static_cast<int>(i), depth + 1);
+            file << "}";
+            first = false;
+        }
+        file << (first ? "]" : "\n" + indent + "]");
+    }
+
+    void printChildren(int parent, int depth) {
+        for (size_t i = 0; i < stages.size(); i++) {
+            if (stages[i].parent != parent) continue;
+
+            std::cout << std::string(depth * 2, ' ') << stages[i].name << ": " << (stages[i].end - stages[i].start) / 1000.0 << " ms" << std::endl;
+            printChildren(static_cast<int>(i), depth + 1);
+        }
+    }
+};
+
+class ProfileScope {
+public:
+    ProfileScope(StartupProfiler& profiler, const char* name) : profiler(profiler) {
+        profiler.begin(name);
+    }
+
+    ~ProfileScope() {
+        profiler.end();
+    }
+
+private:
+    StartupProfiler& profiler;
+};
+
+class HostAllocator {
+public:
+    HostAllocator() : pools(std::make_shared<PoolState>()) {
+        for (uint32_t i = 0; i < OBJECT_TYPE_SLOT_COUNT; i++) {
+            TypedCallbacks& typed = typedCallbacks[i];
+            typed.allocator = this;
+            typed.objectTypeSlot = i;
+            typed.callbacks.pUserData = &typed;
+            typed.callbacks.pfnAllocation = allocate;
+            typed.callbacks.pfnReallocation = reallocate;
+            typed.callbacks.pfnFree = free;
+            typed.callbacks.pfnInternalAllocation = internalAllocation;
+            typed.callbacks.pfnInternalFree = internalFree;
+        }
+    }
+
+    // Every Vulkan object is gone by now. The destroying thread drops its cached pools right away, so back-to-back
+    // instances such as auto-tune trials do not carry them over; other threads drop theirs the next time they
+    // allocate, or when they exit.
+    ~HostAllocator() {
+        auto& entries = threadCache.entries;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [this](const auto& entry) { return entry.first == pools; }), entries.end());
+
+        std::lock_guard<std::mutex> lock(pools->mutex);
+        pools->closed = true;
+        for (void* chunk : pools->chunks) {
+            std::free(chunk);
+        }
+        pools->chunks.clear();
+    }
+
+    HostAllocator(const HostAllocator&) = delete;
+    HostAllocator& operator=(const HostAllocator&) = delete;
+
+    // Each object type has its own callbacks, so allocations are charged to the type they were made for whichever
+    // thread makes them, including driver allocations made later for that object.
+    const VkAllocationCallbacks* callbacks(VkObjectType objectType) {
+        return &typedCallbacks[objectTypeSlot(objectType)].callbacks;
+    }
+
+    void printStatistics() {
+        std::cout << "host allocations: peak " << peakBytes.load() << " bytes, " << reservedBytes.load() << " bytes reserved in arenas" << std::endl;
+
+        for (size_t i = 0; i < SCOPE_COUNT; i++) {
+            const Counters& counters = scopeCounters[i];
+            if (counters.allocations.load() == 0) continue;
+
+            std::cout << "  scope " << scopeNames[i] << ": " << counters.allocations.load() << " allocations, " << counters.frees.load() << " frees, "
+                      << counters.currentBytes.load() << " bytes live, peak " << counters.peakBytes.load() << " bytes" << std::endl;
+        }
+
+        for (size_t i = 0; i < OBJECT_TYPE_SLOT_COUNT; i++) {
+            const Counters& counters = objectTypeCounters[i];
+            if (counters.allocations.load() == 0) continue;
+
+            std::cout << "  object " << objectTypeNames[i] << ": " << counters.allocations.load() << " allocations, "
+                      << counters.currentBytes.load() << " bytes live, peak " << counters.peakBytes.load() << " bytes" << std::endl;
+        }
+
+        if (internalAllocations.load() > 0) {
+            std::cout << "  internal: " << internalAllocations.load() << " allocations, peak " << internalPeakBytes.load() << " bytes" << std::endl;
+        }
+    }
+
+private:
+    static constexpr size_t SCOPE_COUNT = 5;
+    static constexpr size_t SIZE_CLASS_COUNT = 7;
+    static constexpr size_t MIN_SIZE_CLASS = 64;
+    static constexpr size_t LARGE_CLASS = SIZE_CLASS_COUNT;
+    static constexpr size_t ARENA_CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t OBJECT_TYPE_SLOT_COUNT = 29;
+
+    static constexpr const char* scopeNames[SCOPE_COUNT] = {
+        "command", "object", "cache", "device", "instance"
+    };
+
+    static constexpr const char* objectTypeNames[OBJECT_TYPE_SLOT_COUNT] = {
+        "unknown", "instance", "physical device", "device", "queue", "semaphore", "command buffer", "fence",
+        "device memory", "buffer", "image", "event", "query pool", "buffer view", "image view", "shader module",
+        "pipeline cache", "pipeline layout", "render pass", "pipeline", "descriptor set layout", "sampler",
+        "descriptor pool", "descriptor set", "framebuffer", "command pool", "surface", "swapchain", "debug messenger"
+    };
+
+    struct alignas(16) BlockHeader {
+        void* raw;
+        size_t size;
+        uint32_t sizeClass;
+        uint32_t scope;
+        uint32_t objectTypeSlot;
+    };
+
+    struct Counters {
+        std::atomic<size_t> allocations{0};
+        std::atomic<size_t> frees{0};
+        std::atomic<size_t> currentBytes{0};
+        std::atomic<size_t> peakBytes{0};
+    };
+
+    struct TypedCallbacks {
+        VkAllocationCallbacks callbacks{};
+        HostAllocator* allocator = nullptr;
+        uint32_t objectTypeSlot = 0;
+    };
+
+    struct ThreadPools {
+        std::array<std::array<void*, SIZE_CLASS_COUNT>, SCOPE_COUNT> freeLists{};
+        std::array<char*, SCOPE_COUNT> arenaCursor{};
+        std::array<char*, SCOPE_COUNT> arenaEnd{};
+    };
+
+    // Arena chunks and per-thread pools belong to the allocator. A thread that exits hands its pools, free lists
+    // included, back for the next thread to reuse, and the chunks are freed with the allocator.
+    struct PoolState {
+        std::mutex mutex;
+        std::vector<void*> chunks;
+        std::vector<std::unique_ptr<ThreadPools>> threadPools;
+        std::vector<ThreadPools*> idlePools;
+        std::atomic<bool> closed{false};
+    };
+
+    struct ThreadCache {
+        std::vector<std::pair<std::shared_ptr<PoolState>, ThreadPools*>> entries;
+
+        ~ThreadCache() {
+            for (auto& entry : entries) {
+                releasePools(*entry.first, entry.second);
+            }
+        }
+    };
+
+    inline static thread_local ThreadCache threadCache;
+
+    std::array<TypedCallbacks, OBJECT_TYPE_SLOT_COUNT> typedCallbacks;
+    std::shared_ptr<PoolState> pools;
+
+    std::array<Counters, SCOPE_COUNT> scopeCounters;
+    std::array<Counters, OBJECT_TYPE_SLOT_COUNT> objectTypeCounters;
+    std::atomic<size_t> currentBytes{0};
+    std::atomic<size_t> peakBytes{0};
+    std::atomic<size_t> reservedBytes{0};
+    std::atomic<size_t> internalAllocations{0};
+    std::atomic<size_t> internalBytes{0};
+    std::atomic<size_t> internalPeakBytes{0};
+
+    static uint32_t objectTypeSlot(VkObjectType objectType) {
+        if (objectType <= VK_OBJECT_TYPE_COMMAND_POOL) return static_cast<uint32_t>(objectType);
+
+        switch (objectType) {
+            case VK_OBJECT_TYPE_SURFACE_KHR: return 26;
+            case VK_OBJECT_TYPE_SWAPCHAIN_KHR: return 27;
+            case VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT: return 28;
+            default: return 0;
+        }
+    }
+
+    static size_t sizeClassBytes(size_t sizeClass) {
+        return MIN_SIZE_CLASS << sizeClass;
+    }
+
+    static void updatePeak(std::atomic<size_t>& peak, size_t value) {
+        size_t previous = peak.load(std::memory_order_relaxed);
+        while (value > previous && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {}
+    }
+
+    static void addBytes(Counters& counters, size_t size) {
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        updatePeak(counters.peakBytes, counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size);
+    }
+
+    static void removeBytes(Counters& counters, size_t size) {
+        counters.frees.fetch_add(1, std::memory_order_relaxed);
+        counters.currentBytes.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    static void releasePools(PoolState& state, ThreadPools* threadPools) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.closed) {
+            state.idlePools.push_back(threadPools);
+        }
+    }
+
+    ThreadPools& currentThreadPools() {
+        auto& entries = threadCache.entries;
+        for (auto& entry : entries) {
+            if (entry.first == pools) return *entry.second;
+        }
+
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [](const auto& entry) { return entry.first->closed.load(); }), entries.end());
+
+        std::lock_guard<std::mutex> lock(pools->mutex);
+        ThreadPools* threadPools;
+        if (!pools->idlePools.empty()) {
+            threadPools = pools->idlePools.back();
+            pools->idlePools.pop_back();
+        } else {
+            pools->threadPools.push_back(std::make_unique<ThreadPools>());
+            threadPools = pools->threadPools.back().get();
+        }
+        entries.emplace_back(pools, threadPools);
+        return *threadPools;
+    }
+
+    void* allocateRaw(size_t sizeClass, uint32_t scope) {
+        ThreadPools& threadPools = currentThreadPools();
+        void*& freeList = threadPools.freeLists[scope][sizeClass];
+        if (freeList != nullptr) {
+            void* block = freeList;
+            freeList = *static_cast<void**>(block);
+            return block;
+        }
+
+        size_t blockSize = sizeClassBytes(sizeClass);
+        char*& cursor = threadPools.arenaCursor[scope];
+        char*& end = threadPools.arenaEnd[scope];
+        if (cursor == nullptr || static_cast<size_t>(end - cursor) < blockSize) {
+            cursor = static_cast<char*>(std::malloc(ARENA_CHUNK_SIZE));
+            if (cursor == nullptr) return nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(pools->mutex);
+                pools->chunks.push_back(cursor);
+            }
+            end = cursor + ARENA_CHUNK_SIZE;
+            reservedBytes.fetch_add(ARENA_CHUNK_SIZE, std::memory_order_relaxed);
+        }
+
+        void* block = cursor;
+        cursor += blockSize;
+        return block;
+    }
+
+    void* allocateBlock(size_t size, size_t alignment, VkSystemAllocationScope allocationScope, uint32_t objectTypeSlot) {
+        alignment = std::max(alignment, alignof(BlockHeader));
+        size_t needed = sizeof(BlockHeader) + size + alignment - alignof(BlockHeader);
+        uint32_t scope = static_cast<uint32_t>(allocationScope) < SCOPE_COUNT ? static_cast<uint32_t>(allocationScope) : static_cast<uint32_t>(VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+
+        size_t sizeClass = 0;
+        while (sizeClass < SIZE_CLASS_COUNT && sizeClassBytes(sizeClass) < needed) {
+            sizeClass++;
+        }
+
+        void* raw = sizeClass == LARGE_CLASS ? std::malloc(needed + alignof(BlockHeader)) : allocateRaw(sizeClass, scope);
+        if (raw == nullptr) return nullptr;
+
+        uintptr_t user = (reinterpret_cast<uintptr_t>(raw) + sizeof(BlockHeader) + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        BlockHeader* header = reinterpret_cast<BlockHeader*>(user) - 1;
+        header->raw = raw;
+        header->size = size;
+        header->sizeClass = static_cast<uint32_t>(sizeClass);
+        header->scope = scope;
+        header->objectTypeSlot = objectTypeSlot;
+
+        addBytes(scopeCounters[scope], size);
+        addBytes(objectTypeCounters[header->objectTypeSlot], size);
+        updatePeak(peakBytes, currentBytes.fetch_add(size, std::memory_order_relaxed) + size);
+
+        return reinterpret_cast<void*>(user);
+    }
+
+    void freeBlock(void* memory) {
+        BlockHeader* header = static_cast<BlockHeader*>(memory) - 1;
+
+        removeBytes(scopeCounters[header->scope], header->size);
+        removeBytes(objectTypeCounters[header->objectTypeSlot], header->size);
+        currentBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+        void* raw = header->raw;
+        if (header->sizeClass == LARGE_CLASS) {
+            std::free(raw);
+            return;
+        }
+
+        void*& freeList = currentThreadPools().freeLists[header->scope][header->sizeClass];
+        *static_cast<void**>(raw) = freeList;
+        freeList = raw;
+    }
+
+    static VKAPI_ATTR void* VKAPI_CALL allocate(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
+        TypedCallbacks* typed = static_cast<TypedCallbacks*>(pUserData);
+        return typed->allocator->allocateBlock(size, alignment, allocationScope, typed->objectTypeSlot);
+    }
+
+    static VKAPI_ATTR void* VKAPI_CALL reallocate(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
+        TypedCallbacks* typed = static_cast<TypedCallbacks*>(pUserData);
+        HostAllocator* allocator = typed->allocator;
+
+        if (pOriginal == nullptr) {
+            return allocator->allocateBlock(size, alignment, allocationScope, typed->objectTypeSlot);
+        }
+
+        if (size == 0) {
+            allocator->freeBlock(pOriginal);
+            return nullptr;
+        }
+
+        void* memory = allocator->allocateBlock(size, alignment, allocationScope, typed->objectTypeSlot);
+        if (memory == nullptr) return nullptr;
+
+        std::memcpy(memory, pOriginal, std::min(size, (static_cast<BlockHeader*>(pOriginal) - 1)->size));
+        allocator->freeBlock(pOriginal);
+        return memory;
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL free(void* pUserData, void* pMemory) {
+        if (pMemory == nullptr) return;
+
+        static_cast<TypedCallbacks*>(pUserData)->allocator->freeBlock(pMemory);
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL internalAllocation(void* pUserData, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+        HostAllocator* allocator = static_cast<TypedCallbacks*>(pUserData)->allocator;
+        allocator->internalAllocations.fetch_add(1, std::memory_order_relaxed);
+        updatePeak(allocator->internalPeakBytes, allocator->internalBytes.fetch_add(size, std::memory_order_relaxed) + size);
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL internalFree(void* pUserData, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+        static_cast<TypedCallbacks*>(pUserData)->allocator->internalBytes.fetch_sub(size, std::memory_order_relaxed);
+    }
+};
+
+class DeletionQueue {
+public:
+    void setCurrentFrame(uint64_t frame) {
+        currentFrame = frame;
+    }
+
+    uint64_t getCurrentFrame() const {
+        return currentFrame;
+    }
+
+    void push(std::function<void()>&& deleter) {
+        push(currentFrame, std::move(deleter));
+    }
+
+    void push(uint64_t lastUsedFrame, std::function<void()>&& deleter) {
+        pending.push_back({lastUsedFrame, std::move(deleter)});
+    }
+
+    void flush(uint64_t completedFrame) {
+        while (!pending.empty() && pending.front().lastUsedFrame <= completedFrame) {
+            pending.front().deleter();
+            pending.pop_front();
+        }
+    }
+
+    void flushAll() {
+        for (auto& entry : pending) {
+            entry.deleter();
+        }
+        pending.clear();
+    }
+
+private:
+    struct Entry {
+        uint64_t lastUsedFrame;
+        std::function<void()> deleter;
+    };
+
+    std::deque<Entry> pending;
+    uint64_t currentFrame = 0;
+};
+
+template<typename T>
+class DeferredHandle {
+public:
+    using Deleter = void (*)(VkDevice, T, const VkAllocationCallbacks*);
+
+    DeferredHandle() = default;
+
+    DeferredHandle(DeletionQueue& queue, VkDevice device, T handle, Deleter deleter, const VkAllocationCallbacks* allocator) : queue(&queue), device(device), handle(handle), deleter(deleter), allocator(allocator) {}
+
+    DeferredHandle(const DeferredHandle&) = delete;
+    DeferredHandle& operator=(const DeferredHandle&) = delete;
+
+    DeferredHandle(DeferredHandle&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    DeferredHandle& operator=(DeferredHandle&& other) noexcept {
+        if (this != &other) {
+            reset();
+            queue = other.queue;
+            device = other.device;
+            handle = std::exchange(other.handle, VK_NULL_HANDLE);
+            deleter = other.deleter;
+            allocator = other.allocator;
+        }
+        return *this;
+    }
+
+    ~DeferredHandle() {
+        reset();
+    }
+
+    T get() const {
+        return handle;
+    }
+
+    void reset() {
+        if (handle == VK_NULL_HANDLE) return;
+
+        VkDevice device = this->device;
+        T handle = std::exchange(this->handle, VK_NULL_HANDLE);
+        Deleter deleter = this->deleter;
+        const VkAllocationCallbacks* allocator = this->allocator;
+        queue->push([device, handle, deleter, allocator]() {
+            deleter(device, handle, allocator);
+        });
+    }
+
+private:
+    DeletionQueue* queue = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    T handle = VK_NULL_HANDLE;
+    Deleter deleter = nullptr;
+    const VkAllocationCallbacks* allocator = nullptr;
+};
+
+struct MemoryHeapStatus {
+    VkDeviceSize size = 0;
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+    VkDeviceSize allocated = 0;
+    VkDeviceSize peakAllocated = 0;
+    bool deviceLocal = false;
+    bool underPressure = false;
+};
+
+// Every device memory allocation goes through here so it can be accounted per heap. With VK_EXT_memory_budget the
+// driver's budget and usage, which include other processes, are polled; without it usage is what this process has
+// allocated. Allocations that do not fit a device local heap are placed in another heap instead of failing.
+class DeviceMemoryBudget {
+public:
+    // Called with the bytes to release from a heap under pressure, and with 0 once the pressure has passed.
+    using PressureCallback = std::function<void(uint32_t heap, VkDeviceSize bytesToRelease)>;
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, HostAllocator& hostAllocator, bool budgetQueries) {
+        this->physicalDevice = physicalDevice;
+        this->device = device;
+        this->hostAllocator = &hostAllocator;
+        this->budgetQueries = budgetQueries;
+
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        heaps.resize(memoryProperties.memoryHeapCount);
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            heaps[i].size = memoryProperties.memoryHeaps[i].size;
+            heaps[i].budget = static_cast<VkDeviceSize>(heaps[i].size * MEMORY_FALLBACK_BUDGET);
+            heaps[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        }
+        poll();
+    }
+
+    void addPressureCallback(PressureCallback callback) {
+        pressureCallbacks.push_back(std::move(callback));
+    }
+
+    // Memory types with all of the required flags come first, those with the preferred flags and room in their
+    // heap's budget before the rest. Device local requests then fall back to the types without that flag.
+    VkResult allocate(VkDeviceSize size, uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkDeviceMemory& memory) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::vector<uint32_t> candidates = candidateTypes(size, typeFilter, required, preferred);
+        size_t primaryCount = candidates.size();
+        if (required & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+            for (uint32_t type : candidateTypes(size, typeFilter, required & ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0)) {
+                if (std::find(candidates.begin(), candidates.end(), type) == candidates.end()) candidates.push_back(type);
+            }
+        }
+
+        VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            uint32_t heap = memoryProperties.memoryTypes[candidates[i]].heapIndex;
+            if (i < primaryCount && !fitsBudget(heap, size)) {
+                pollRequested = true;
+            }
+
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = size;
+            allocInfo.memoryTypeIndex = candidates[i];
+
+            result = vkAllocateMemory(device, &allocInfo, hostAllocator->callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &memory);
+            if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+                pollRequested = true;
+                continue;
+            }
+            if (result != VK_SUCCESS) return result;
+
+            if (i >= primaryCount) {
+                fallbackAllocations++;
+            }
+            allocations[memory] = {heap, size};
+            heaps[heap].allocated += size;
+            heaps[heap].peakAllocated = std::max(heaps[heap].peakAllocated, heaps[heap].allocated);
+            return VK_SUCCESS;
+        }
+
+        return result;
+    }
+
+    void free(VkDeviceMemory memory) {
+        if (memory == VK_NULL_HANDLE) return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto allocation = allocations.find(memory);
+            if (allocation != allocations.end()) {
+                heaps[allocation->second.heap].allocated -= allocation->second.size;
+                allocations.erase(allocation);
+            }
+        }
+        vkFreeMemory(device, memory, hostAllocator->callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    }
+
+    // Polls the budgets every MEMORY_BUDGET_POLL_INTERVAL calls, or on the next call after an allocation did not fit,
+    // and runs the pressure callbacks. The callbacks may allocate and free memory themselves.
+    void update() {
+        std::vector<std::pair<uint32_t, VkDeviceSize>> notifications;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++updateCount % MEMORY_BUDGET_POLL_INTERVAL != 0 && !pollRequested) return;
+            poll();
+
+            for (uint32_t i = 0; i < heaps.size(); i++) {
+                MemoryHeapStatus& heap = heaps[i];
+                VkDeviceSize relief = static_cast<VkDeviceSize>(heap.budget * MEMORY_PRESSURE_RELIEF);
+                if (heap.usage > heap.budget * MEMORY_PRESSURE_THRESHOLD || (heap.underPressure && heap.usage > relief)) {
+                    if (!heap.underPressure) pressureEvents++;
+                    heap.underPressure = true;
+                    notifications.push_back({i, heap.usage - relief});
+                } else if (heap.underPressure) {
+                    heap.underPressure = false;
+                    notifications.push_back({i, 0});
+                }
+            }
+        }
+
+        for (const auto& [heap, bytesToRelease] : notifications) {
+            for (const auto& callback : pressureCallbacks) {
+                callback(heap, bytesToRelease);
+            }
+        }
+    }
+
+    MemoryHeapStatus getHeapStatus(uint32_t heap) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return heaps[heap];
+    }
+
+    uint32_t getHeapCount() const {
+        return static_cast<uint32_t>(heaps.size());
+    }
+
+    void report() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t i = 0; i < heaps.size(); i++) {
+            const MemoryHeapStatus& heap = heaps[i];
+            if (heap.peakAllocated == 0) continue;
+            std::cout << "memory heap " << i << (heap.deviceLocal ? " (device local)" : "") << ": usage " << heap.usage / (1024 * 1024)
+                      << " MiB of " << heap.budget / (1024 * 1024) << " MiB budget" << (budgetQueries ? "" : " (estimated)")
+                      << ", peak " << heap.peakAllocated / (1024 * 1024) << " MiB allocated by this process" << std::endl;
+        }
+        if (fallbackAllocations > 0 || pressureEvents > 0) {
+            std::cout << fallbackAllocations << " allocations placed in a fallback heap, " << pressureEvents << " memory pressure events" << std::endl;
+        }
+    }
+
+private:
+    struct Allocation {
+        uint32_t heap;
+        VkDeviceSize size;
+    };
+
+    bool fitsBudget(uint32_t heap, VkDeviceSize size) const {
+        return heaps[heap].usage + size <= heaps[heap].budget;
+    }
+
+    std::vector<uint32_t> candidateTypes(VkDeviceSize size, uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const {
+        std::vector<uint32_t> types;
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & required) == required) {
+                types.push_back(i);
+            }
+        }
+
+        std::stable_sort(types.begin(), types.end(), [&](uint32_t a, uint32_t b) {
+            auto rank = [&](uint32_t type) {
+                const VkMemoryType& memoryType = memoryProperties.memoryTypes[type];
+                return (fitsBudget(memoryType.heapIndex, size) ? 0 : 2) + ((memoryType.propertyFlags & preferred) == preferred ? 0 : 1);
+            };
+            return rank(a) < rank(b);
+        });
+        return types;
+    }
+
+    void poll() {
+        pollRequested = false;
+        if (!budgetQueries) {
+            for (auto& heap : heaps) {
+                heap.usage = heap.allocated;
+            }
+            return;
+        }
+
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+
+        for (uint32_t i = 0; i < heaps.size(); i++) {
+            heaps[i].budget = budgetProperties.heapBudget[i];
+            heaps[i].usage = budgetProperties.heapUsage[i];
+        }
+    }
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    HostAllocator* hostAllocator = nullptr;
+    bool budgetQueries = false;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+
+    std::mutex mutex;
+    std::vector<MemoryHeapStatus> heaps;
+    std::map<VkDeviceMemory, Allocation> allocations;
+    std::vector<PressureCallback> pressureCallbacks;
+    uint64_t updateCount = 0;
+    bool pollRequested = false;
+    uint64_t fallbackAllocations = 0;
+    uint64_t pressureEvents = 0;
+};
+
+// Device-level entry points of the per-frame path, resolved once through vkGetDeviceProcAddr so that each call goes
+// straight to the driver instead of through the loader's trampoline. Extension entry points stay null unless their
+// extension was enabled on the device.
+struct DeviceDispatch {
+    PFN_vkWaitForFences waitForFences = nullptr;
+    PFN_vkResetFences resetFences = nullptr;
+    PFN_vkGetFenceStatus getFenceStatus = nullptr;
+    PFN_vkAcquireNextImageKHR acquireNextImage = nullptr;
+    PFN_vkQueueSubmit queueSubmit = nullptr;
+    PFN_vkQueuePresentKHR queuePresent = nullptr;
+    PFN_vkResetCommandBuffer resetCommandBuffer = nullptr;
+    PFN_vkBeginCommandBuffer beginCommandBuffer = nullptr;
+    PFN_vkEndCommandBuffer endCommandBuffer = nullptr;
+    PFN_vkGetQueryPoolResults getQueryPoolResults = nullptr;
+    PFN_vkInvalidateMappedMemoryRanges invalidateMappedMemoryRanges = nullptr;
+    PFN_vkCmdBeginRenderPass cmdBeginRenderPass = nullptr;
+    PFN_vkCmdEndRenderPass cmdEndRenderPass = nullptr;
+    PFN_vkCmdSetViewport cmdSetViewport = nullptr;
+    PFN_vkCmdSetScissor cmdSetScissor = nullptr;
+    PFN_vkCmdBindPipeline cmdBindPipeline = nullptr;
+    PFN_vkCmdBindDescriptorSets cmdBindDescriptorSets = nullptr;
+    PFN_vkCmdPushConstants cmdPushConstants = nullptr;
+    PFN_vkCmdBindVertexBuffers cmdBindVertexBuffers = nullptr;
+    PFN_vkCmdBindIndexBuffer cmdBindIndexBuffer = nullptr;
+    PFN_vkCmdDrawIndexed cmdDrawIndexed = nullptr;
+    PFN_vkCmdDrawIndexedIndirect cmdDrawIndexedIndirect = nullptr;
+    PFN_vkCmdDispatch cmdDispatch = nullptr;
+    PFN_vkCmdFillBuffer cmdFillBuffer = nullptr;
+    PFN_vkCmdPipelineBarrier cmdPipelineBarrier = nullptr;
+    PFN_vkCmdBlitImage cmdBlitImage = nullptr;
+    PFN_vkCmdCopyImageToBuffer cmdCopyImageToBuffer = nullptr;
+    PFN_vkCmdResetQueryPool cmdResetQueryPool = nullptr;
+    PFN_vkCmdWriteTimestamp cmdWriteTimestamp = nullptr;
+    PFN_vkCmdBeginQuery cmdBeginQuery = nullptr;
+    PFN_vkCmdEndQuery cmdEndQuery = nullptr;
+
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+    PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2 = nullptr;
+    PFN_vkQueueSubmit2KHR queueSubmit2 = nullptr;
+    PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+
+    void load(VkDevice device) {
+        load(device, "vkWaitForFences", waitForFences);
+        load(device, "vkResetFences", resetFences);
+        load(device, "vkGetFenceStatus", getFenceStatus);
+        load(device, "vkAcquireNextImageKHR", acquireNextImage);
+        load(device, "vkQueueSubmit", queueSubmit);
+        load(device, "vkQueuePresentKHR", queuePresent);
+        load(device, "vkResetCommandBuffer", resetCommandBuffer);
+        load(device, "vkBeginCommandBuffer", beginCommandBuffer);
+        load(device, "vkEndCommandBuffer", endCommandBuffer);
+        load(device, "vkGetQueryPoolResults", getQueryPoolResults);
+        load(device, "vkInvalidateMappedMemoryRanges", invalidateMappedMemoryRanges);
+        load(device, "vkCmdBeginRenderPass", cmdBeginRenderPass);
+        load(device, "vkCmdEndRenderPass", cmdEndRenderPass);
+        load(device, "vkCmdSetViewport", cmdSetViewport);
+        load(device, "vkCmdSetScissor", cmdSetScissor);
+        load(device, "vkCmdBindPipeline", cmdBindPipeline);
+        load(device, "vkCmdBindDescriptorSets", cmdBindDescriptorSets);
+        load(device, "vkCmdPushConstants", cmdPushConstants);
+        load(device, "vkCmdBindVertexBuffers", cmdBindVertexBuffers);
+        load(device, "vkCmdBindIndexBuffer", cmdBindIndexBuffer);
+        load(device, "vkCmdDrawIndexed", cmdDrawIndexed);
+        load(device, "vkCmdDrawIndexedIndirect", cmdDrawIndexedIndirect);
+        load(device, "vkCmdDispatch", cmdDispatch);
+        load(device, "vkCmdFillBuffer", cmdFillBuffer);
+        load(device, "vkCmdPipelineBarrier", cmdPipelineBarrier);
+        load(device, "vkCmdBlitImage", cmdBlitImage);
+        load(device, "vkCmdCopyImageToBuffer", cmdCopyImageToBuffer);
+        load(device, "vkCmdResetQueryPool", cmdResetQueryPool);
+        load(device, "vkCmdWriteTimestamp", cmdWriteTimestamp);
+        load(device, "vkCmdBeginQuery", cmdBeginQuery);
+        load(device, "vkCmdEndQuery", cmdEndQuery);
+    }
+
+private:
+    template<typename Function>
+    static void load(VkDevice device, const char* name, Function& function) {
+        function = (Function) vkGetDeviceProcAddr(device, name);
+        if (function == nullptr) {
+            throw std::runtime_error(std::string("failed to load ") + name + "!");
+        }
+    }
+};
+
+const uint32_t MAX_GPU_SCOPES = 16;
+const size_t GPU_PROFILE_WINDOW = 120;
+
+struct GpuScopeSample {
+    const char* name;
+    double milliseconds;
+    bool hasStatistics;
+    uint64_t vertexInvocations;
+    uint64_t fragmentInvocations;
+    uint64_t computeInvocations;
+};
+
+// Scoped GPU timing for the graphics command buffer. Every frame slot owns MAX_GPU_SCOPES timestamp pairs and
+// pipeline statistics queries, and its results are read without waiting once the slot's fence has signalled,
+// the frames in flight after recording. On a queue without timestamps, or a device without pipeline
+// statistics, that half of the profiler records nothing.
+class GpuProfiler {
+public:
+    void init(VkDevice device, const DeviceDispatch& dispatch, HostAllocator& hostAllocator, uint32_t frameCount, uint32_t timestampValidBits, float timestampPeriod, bool statisticsSupported) {
+        this->device = device;
+        this->dispatch = &dispatch;
+        this->hostAllocator = &hostAllocator;
+        this->timestampPeriod = timestampPeriod;
+        timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampValidBits) - 1;
+        frames.resize(frameCount);
+
+        if (timestampValidBits > 0) {
+            timestampPool = createPool(VK_QUERY_TYPE_TIMESTAMP, frameCount * MAX_GPU_SCOPES * 2, 0);
+        }
+        if (statisticsSupported) {
+            statisticsPool = createPool(VK_QUERY_TYPE_PIPELINE_STATISTICS, frameCount * MAX_GPU_SCOPES, STATISTICS);
+        }
+    }
+
+    void destroy() {
+        for (VkQueryPool pool : {timestampPool, statisticsPool}) {
+            if (pool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(device, pool, hostAllocator->callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+            }
+        }
+        timestampPool = VK_NULL_HANDLE;
+        statisticsPool = VK_NULL_HANDLE;
+    }
+
+    bool timestampsSupported() const {
+        return timestampPool != VK_NULL_HANDLE;
+    }
+
+    bool statisticsSupported() const {
+        return statisticsPool != VK_NULL_HANDLE;
+    }
+
+    // Must be recorded outside any render pass, before the first scope of the frame.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame) {
+        currentFrame = frame;
+        frames[frame].scopes.clear();
+        if (timestampPool != VK_NULL_HANDLE) {
+            dispatch->cmdResetQueryPool(commandBuffer, timestampPool, frame * MAX_GPU_SCOPES * 2, MAX_GPU_SCOPES * 2);
+        }
+        if (statisticsPool != VK_NULL_HANDLE) {
+            dispatch->cmdResetQueryPool(commandBuffer, statisticsPool, frame * MAX_GPU_SCOPES, MAX_GPU_SCOPES);
+        }
+    }
+
+    // Statistics queries cannot nest, so a scope nested in another statistics scope only gets timestamps.
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name, bool statistics = false) {
+        std::vector<Scope>& scopes = frames[currentFrame].scopes;
+        if ((!timestampsSupported() && !statisticsSupported()) || scopes.size() == MAX_GPU_SCOPES) return UINT32_MAX;
+
+        bool withStatistics = statistics && statisticsSupported() && !statisticsActive;
+        uint32_t scope = static_cast<uint32_t>(scopes.size());
+        uint32_t query = currentFrame * MAX_GPU_SCOPES + scope;
+        scopes.push_back({name, withStatistics});
+
+        if (timestampPool != VK_NULL_HANDLE) {
+            dispatch->cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, query * 2);
+        }
+        if (withStatistics) {
+            dispatch->cmdBeginQuery(commandBuffer, statisticsPool, query, 0);
+            statisticsActive = true;
+        }
+        return scope;
+    }
+
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+        if (scope == UINT32_MAX) return;
+
+        uint32_t query = currentFrame * MAX_GPU_SCOPES + scope;
+        if (frames[currentFrame].scopes[scope].statistics) {
+            dispatch->cmdEndQuery(commandBuffer, statisticsPool, query);
+            statisticsActive = false;
+        }
+        if (timestampPool != VK_NULL_HANDLE) {
+            dispatch->cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, query * 2 + 1);
+        }
+    }
+
+    // Reads the slot's results without waiting. Returns false if the slot recorded nothing since it was last
+    // collected or its results are not available yet; otherwise getSamples() holds one sample per scope, in the
+    // order the scopes were begun.
+    bool collect(uint32_t frame) {
+        samples.clear();
+        std::vector<Scope>& scopes = frames[frame].scopes;
+        if (scopes.empty()) return false;
+
+        uint32_t count = static_cast<uint32_t>(scopes.size());
+        uint32_t firstQuery = frame * MAX_GPU_SCOPES;
+        if (timestampPool != VK_NULL_HANDLE) {
+            timestampResults.resize(count * 2);
+            if (dispatch->getQueryPoolResults(device, timestampPool, firstQuery * 2, count * 2, timestampResults.size() * sizeof(uint64_t), timestampResults.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+                return false;
+            }
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            GpuScopeSample sample{scopes[i].name, 0.0, false, 0, 0, 0};
+            if (timestampPool != VK_NULL_HANDLE) {
+                uint64_t ticks = ((timestampResults[i * 2 + 1] & timestampMask) - (timestampResults[i * 2] & timestampMask)) & timestampMask;
+                sample.milliseconds = ticks * timestampPeriod / 1e6;
+            }
+
+            // Results come in bit order: vertex, fragment, compute.
+            uint64_t statistics[3];
+            if (scopes[i].statistics && dispatch->getQueryPoolResults(device, statisticsPool, firstQuery + i, 1, sizeof(statistics), statistics, sizeof(statistics), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                sample.hasStatistics = true;
+                sample.vertexInvocations = statistics[0];
+                sample.fragmentInvocations = statistics[1];
+                sample.computeInvocations = statistics[2];
+            }
+
+            samples.push_back(sample);
+            addToHistory(sample);
+        }
+
+        scopes.clear();
+        return true;
+    }
+
+    const std::vector<GpuScopeSample>& getSamples() const {
+        return samples;
+    }
+
+    void report() const {
+        if (history.empty()) return;
+
+        std::cout << "gpu profile (last " << GPU_PROFILE_WINDOW << " frames):" << std::endl;
+        for (const auto& [name, scopeHistory] : history) {
+            size_t count = std::min(scopeHistory.count, GPU_PROFILE_WINDOW);
+            auto begin = scopeHistory.milliseconds.begin();
+            double mean = std::accumulate(begin, begin + count, 0.0) / count;
+            auto [minimum, maximum] = std::minmax_element(begin, begin + count);
+
+            std::cout << "  " << std::left << std::setw(10) << name << std::right;
+            if (timestampsSupported()) {
+                std::cout << " mean " << mean << " ms, min " << *minimum << " ms, max " << *maximum << " ms";
+            }
+            if (scopeHistory.hasStatistics) {
+                std::cout << "; invocations: vertex " << scopeHistory.last.vertexInvocations << ", fragment " << scopeHistory.last.fragmentInvocations
+                          << ", compute " << scopeHistory.last.computeInvocations;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+private:
+    static constexpr VkQueryPipelineStatisticFlags STATISTICS = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    struct Scope {
+        const char* name;
+        bool statistics;
+    };
+
+    struct FrameQueries {
+        std::vector<Scope> scopes;
+    };
+
+    struct ScopeHistory {
+        std::array<double, GPU_PROFILE_WINDOW> milliseconds{};
+        size_t count = 0;
+        bool hasStatistics = false;
+        GpuScopeSample last{};
+    };
+
+    VkQueryPool createPool(VkQueryType type, uint32_t count, VkQueryPipelineStatisticFlags statistics) {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = type;
+        queryPoolInfo.queryCount = count;
+        queryPoolInfo.pipelineStatistics = statistics;
+
+        VkQueryPool pool;
+        if (vkCreateQueryPool(device, &queryPoolInfo, hostAllocator->callbacks(VK_OBJECT_TYPE_QUERY_POOL), &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create gpu profiler query pool!");
+        }
+        return pool;
+    }
+
+    void addToHistory(const GpuScopeSample& sample) {
+        ScopeHistory& scopeHistory = history[sample.name];
+        scopeHistory.milliseconds[scopeHistory.count % GPU_PROFILE_WINDOW] = sample.milliseconds;
+        scopeHistory.count++;
+        if (sample.hasStatistics) {
+            scopeHistory.hasStatistics = true;
+            scopeHistory.last = sample;
+        }
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    const DeviceDispatch* dispatch = nullptr;
+    HostAllocator* hostAllocator = nullptr;
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    VkQueryPool statisticsPool = VK_NULL_HANDLE;
+    uint64_t timestampMask = 0;
+    double timestampPeriod = 0.0;
+
+    std::vector<FrameQueries> frames;
+    uint32_t currentFrame = 0;
+    bool statisticsActive = false;
+    std::vector<uint64_t> timestampResults;
+    std::vector<GpuScopeSample> samples;
+    std::map<std::string, ScopeHistory> history;
+};
+
+// Collects the command buffers and semaphore operations of a frame as batches per queue, and submits all batches of a
+// queue with one call. With synchronization2 every semaphore wait and signal carries its own stage mask; otherwise the
+// batches become VkSubmitInfos, which is why stage masks must stay within the bits the legacy flags can express.
+class QueueSubmitter {
+public:
+    void init(const DeviceDispatch& dispatch) {
+        this->dispatch = &dispatch;
+    }
+
+    bool synchronization2() const {
+        return dispatch->queueSubmit2 != nullptr;
+    }
+
+    // Starts a new batch on queue; the calls below add to it until the next begin.
+    void begin(VkQueue queue) {
+        batches.push_back({queue, {}, {}, {}});
+    }
+
+    void wait(VkSemaphore semaphore, VkPipelineStageFlags2 stages) {
+        batches.back().waits.push_back(semaphoreInfo(semaphore, stages));
+    }
+
+    void addCommandBuffer(VkCommandBuffer commandBuffer) {
+        VkCommandBufferSubmitInfo commandBufferInfo{};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        commandBufferInfo.commandBuffer = commandBuffer;
+        batches.back().commandBuffers.push_back(commandBufferInfo);
+    }
+
+    void signal(VkSemaphore semaphore, VkPipelineStageFlags2 stages) {
+        batches.back().signals.push_back(semaphoreInfo(semaphore, stages));
+    }
+
+    bool hasPending(VkQueue queue) const {
+        return std::any_of(batches.begin(), batches.end(), [queue](const Batch& batch) { return batch.queue == queue; });
+    }
+
+    // Submits every pending batch of queue, in the order they were begun, and signals fence once all of them complete.
+    VkResult flush(VkQueue queue, VkFence fence) {
+        std::vector<Batch> queueBatches;
+        for (auto it = batches.begin(); it != batches.end();) {
+            if (it->queue == queue) {
+                queueBatches.push_back(std::move(*it));
+                it = batches.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (queueBatches.empty() && fence == VK_NULL_HANDLE) return VK_SUCCESS;
+
+        frameCalls++;
+        frameBatches += queueBatches.size();
+        return synchronization2() ? submit2(queue, queueBatches, fence) : submit(queue, queueBatches, fence);
+    }
+
+    void endFrame() {
+        frames++;
+        totalCalls += frameCalls;
+        totalBatches += frameBatches;
+        maxFrameCalls = std::max(maxFrameCalls, frameCalls);
+        frameCalls = 0;
+        frameBatches = 0;
+    }
+
+    void report() const {
+        if (frames == 0) return;
+
+        std::cout << (synchronization2() ? "vkQueueSubmit2" : "vkQueueSubmit") << ": " << static_cast<double>(totalCalls) / frames
+                  << " calls and " << static_cast<double>(totalBatches) / frames << " batches per frame, at most " << maxFrameCalls
+                  << " calls in a frame" << std::endl;
+    }
+
+private:
+    struct Batch {
+        VkQueue queue;
+        std::vector<VkSemaphoreSubmitInfo> waits;
+        std::vector<VkCommandBufferSubmitInfo> commandBuffers;
+        std::vector<VkSemaphoreSubmitInfo> signals;
+    };
+
+    static VkSemaphoreSubmitInfo semaphoreInfo(VkSemaphore semaphore, VkPipelineStageFlags2 stages) {
+        VkSemaphoreSubmitInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        info.semaphore = semaphore;
+        info.stageMask = stages;
+        return info;
+    }
+
+    VkResult submit2(VkQueue queue, const std::vector<Batch>& queueBatches, VkFence fence) {
+        std::vector<VkSubmitInfo2> submitInfos;
+        for (const auto& batch : queueBatches) {
+            VkSubmitInfo2 submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+            submitInfo.waitSemaphoreInfoCount = static_cast<uint32_t>(batch.waits.size());
+            submitInfo.pWaitSemaphoreInfos = batch.waits.data();
+            submitInfo.commandBufferInfoCount = static_cast<uint32_t>(batch.commandBuffers.size());
+            submitInfo.pCommandBufferInfos = batch.commandBuffers.data();
+            submitInfo.signalSemaphoreInfoCount = static_cast<uint32_t>(batch.signals.size());
+            submitInfo.pSignalSemaphoreInfos = batch.signals.data();
+            submitInfos.push_back(submitInfo);
+        }
+
+        return dispatch->queueSubmit2(queue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), fence);
+    }
+
+    VkResult submit(VkQueue queue, const std::vector<Batch>& queueBatches, VkFence fence) {
+        size_t waitCount = 0, commandBufferCount = 0, signalCount = 0;
+        for (const auto& batch : queueBatches) {
+            waitCount += batch.waits.size();
+            commandBufferCount += batch.commandBuffers.size();
+            signalCount += batch.signals.size();
+        }
+
+        // Reserved up front so the pointers taken below stay valid.
+        std::vector<VkSemaphore> waitSemaphores, signalSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<VkCommandBuffer> commandBuffers;
+        waitSemaphores.reserve(waitCount);
+        waitStages.reserve(waitCount);
+        commandBuffers.reserve(commandBufferCount);
+        signalSemaphores.reserve(signalCount);
+
+        std::vector<VkSubmitInfo> submitInfos;
+        for (const auto& batch : queueBatches) {
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.waitSemaphoreCount = static_cast<uint32_t>(batch.waits.size());
+            submitInfo.pWaitSemaphores = waitSemaphores.data() + waitSemaphores.size();
+            submitInfo.pWaitDstStageMask = waitStages.data() + waitStages.size();
+            for (const auto& wait : batch.waits) {
+                waitSemaphores.push_back(wait.semaphore);
+                waitStages.push_back(static_cast<VkPipelineStageFlags>(wait.stageMask));
+            }
+
+            submitInfo.commandBufferCount = static_cast<uint32_t>(batch.commandBuffers.size());
+            submitInfo.pCommandBuffers = commandBuffers.data() + commandBuffers.size();
+            for (const auto& commandBuffer : batch.commandBuffers) {
+                commandBuffers.push_back(commandBuffer.commandBuffer);
+            }
+
+            submitInfo.signalSemaphoreCount = static_cast<uint32_t>(batch.signals.size());
+            submitInfo.pSignalSemaphores = signalSemaphores.data() + signalSemaphores.size();
+            for (const auto& signal : batch.signals) {
+                signalSemaphores.push_back(signal.semaphore);
+            }
+            submitInfos.push_back(submitInfo);
+        }
+
+        return dispatch->queueSubmit(queue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), fence);
+    }
+
+    const DeviceDispatch* dispatch = nullptr;
+    std::vector<Batch> batches;
+    uint64_t frameCalls = 0;
+    uint64_t frameBatches = 0;
+    uint64_t frames = 0;
+    uint64_t totalCalls = 0;
+    uint64_t totalBatches = 0;
+    uint64_t maxFrameCalls = 0;
+};
+
+enum class RenderGraphAccess {
+    ColorAttachment,
+    DepthAttachment,
+    ShaderRead,
+    TransferSrc,
+    TransferDst,
+    Present
+};
+
+struct RenderGraphImageDesc {
+    VkFormat format;
+    VkExtent2D extent;
+    VkSampleCountFlagBits samples;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+};
+
+class RenderGraph {
+public:
+    using RecordFunction = std::function<void(VkCommandBuffer)>;
+    using AllocateFunction = std::function<VkDeviceMemory(const VkMemoryRequirements&, VkImageUsageFlags)>;
+
+    // With synchronization2 every barrier is recorded with its own stage masks instead of those of its whole batch.
+    void init(VkDevice device, HostAllocator& hostAllocator, DeviceMemoryBudget& memoryBudget, DeletionQueue& deletionQueue, AllocateFunction allocateMemory,
+        const DeviceDispatch& dispatch) {
+        this->device = device;
+        this->hostAllocator = &hostAllocator;
+        this->memoryBudget = &memoryBudget;
+        this->deletionQueue = &deletionQueue;
+        this->allocateMemory = std::move(allocateMemory);
+        this->dispatch = &dispatch;
+    }
+
+    void reset() {
+        resources.clear();
+        passes.clear();
+    }
+
+    uint32_t createImage(const char* name, const RenderGraphImageDesc& desc) {
+        resources.push_back({name, desc, false, RenderGraphAccess::Present, VK_NULL_HANDLE, VK_NULL_HANDLE});
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    uint32_t importImage(const char* name, const RenderGraphImageDesc& desc, VkImage image, VkImageView imageView, RenderGraphAccess finalAccess) {
+        resources.push_back({name, desc, true, finalAccess, image, imageView});
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    uint32_t addPass(const char* name, RecordFunction&& record) {
+        passes.push_back({name, {}, std::move(record)});
+        return static_cast<uint32_t>(passes.size() - 1);
+    }
+
+    void read(uint32_t pass, uint32_t resource, RenderGraphAccess access) {
+        passes[pass].accesses.push_back({resource, access, false});
+    }
+
+    void write(uint32_t pass, uint32_t resource, RenderGraphAccess access) {
+        passes[pass].accesses.push_back({resource, access, true});
+    }
+
+    VkImage getImage(uint32_t resource) const {
+        return resources[resource].imported ? resources[resource].image : transientImages[resource];
+    }
+
+    VkImageView getImageView(uint32_t resource) const {
+        return resources[resource].imported ? resources[resource].imageView : transientImageViews[resource];
+    }
+
+    // The stages of the first access to a resource in the compiled graph. A semaphore guarding an imported image
+    // must be waited on at these stages for the first barrier to chain off the wait.
+    VkPipelineStageFlags getFirstAccessStages(uint32_t resource) const {
+        return firstAccessStages[resource];
+    }
+
+    bool compile() {
+        uint64_t hash = structureHash();
+        if (compiled && hash == compiledHash) return false;
+
+        std::vector<bool> alive = cullPasses();
+        std::vector<uint32_t> order = sortPasses(alive);
+        retireTransientImages();
+        allocateTransientImages(order);
+        buildBarriers(order);
+
+        size_t batchCount = finalBarriers.barriers.empty() ? 0 : 1;
+        size_t barrierCount = finalBarriers.barriers.size();
+        for (const auto& compiledPass : compiledPasses) {
+            batchCount += compiledPass.barriers.barriers.empty() ? 0 : 1;
+            barrierCount += compiledPass.barriers.barriers.size();
+        }
+
+        std::cout << "render graph: " << order.size() << " passes (" << std::count(alive.begin(), alive.end(), false) << " culled), "
+                  << barrierCount << " barriers in " << batchCount << " batches, "
+                  << transientImageCount << " transient images in " << transientMemory.size() << " allocations ("
+                  << allocatedBytes << " of " << requestedBytes << " bytes)" << std::endl;
+
+        compiled = true;
+        compiledHash = hash;
+        return true;
+    }
+
+    // Each pass is recorded inside a GPU profiler scope named after it.
+    void execute(VkCommandBuffer commandBuffer, GpuProfiler& profiler) {
+        for (auto& compiledPass : compiledPasses) {
+            recordBarriers(commandBuffer, compiledPass.barriers);
+            uint32_t scope = profiler.beginScope(commandBuffer, passes[compiledPass.pass].name);
+            passes[compiledPass.pass].record(commandBuffer);
+            profiler.endScope(commandBuffer, scope);
+        }
+        recordBarriers(commandBuffer, finalBarriers);
+    }
+
+    void destroy() {
+        for (size_t i = 0; i < transientImages.size(); i++) {
+            if (transientImages[i] == VK_NULL_HANDLE) continue;
+            vkDestroyImageView(device, transientImageViews[i], hostAllocator->callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+            vkDestroyImage(device, transientImages[i], hostAllocator->callbacks(VK_OBJECT_TYPE_IMAGE));
+        }
+        for (auto memory : transientMemory) {
+            memoryBudget->free(memory);
+        }
+        transientImages.clear();
+        transientImageViews.clear();
+        transientMemory.clear();
+        compiled = false;
+    }
+
+private:
+    struct Resource {
+        const char* name;
+        RenderGraphImageDesc desc;
+        bool imported;
+        RenderGraphAccess finalAccess;
+        VkImage image;
+        VkImageView imageView;
+    };
+
+    struct Access {
+        uint32_t resource;
+        RenderGraphAccess access;
+        bool write;
+    };
+
+    struct Pass {
+        const char* name;
+        std::vector<Access> accesses;
+        RecordFunction record;
+    };
+
+    struct AccessInfo {
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageLayout layout;
+    };
+
+    struct ResourceState {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags writeAccess = 0;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct Barrier {
+        uint32_t resource;
+        VkPipelineStageFlags srcStages;
+        VkPipelineStageFlags dstStages;
+        VkImageMemoryBarrier barrier;
+    };
+
+    struct BarrierBatch {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<Barrier> barriers;
+    };
+
+    struct CompiledPass {
+        uint32_t pass;
+        BarrierBatch barriers;
+    };
+
+    static constexpr VkAccessFlags WRITE_ACCESS = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    static AccessInfo accessInfo(RenderGraphAccess access) {
+        switch (access) {
+            case RenderGraphAccess::ColorAttachment:
+                return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+            case RenderGraphAccess::DepthAttachment:
+                return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+            case RenderGraphAccess::ShaderRead:
+                return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            case RenderGraphAccess::TransferSrc:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+            case RenderGraphAccess::TransferDst:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+            case RenderGraphAccess::Present:
+                return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+        }
+
+        throw std::runtime_error("unknown render graph access!");
+    }
+
+    uint64_t structureHash() const {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const void* data, size_t size) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; i++) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+        };
+
+        for (const auto& resource : resources) {
+            mix(resource.name, std::strlen(resource.name));
+            mix(&resource.desc, sizeof(resource.desc));
+            mix(&resource.imported, sizeof(resource.imported));
+            mix(&resource.finalAccess, sizeof(resource.finalAccess));
+        }
+        for (const auto& pass : passes) {
+            mix(pass.name, std::strlen(pass.name));
+            for (const auto& access : pass.accesses) {
+                mix(&access.resource, sizeof(access.resource));
+                mix(&access.access, sizeof(access.access));
+                mix(&access.write, sizeof(access.write));
+            }
+        }
+
+        return hash;
+    }
+
+    // Walks the passes backwards from the imported outputs: a pass survives only if it writes something a later
+    // surviving pass reads, and a write without a read ends the resource's liveness above that pass.
+    std::vector<bool> cullPasses() const {
+        std::vector<bool> needed(resources.size(), false);
+        for (size_t i = 0; i < resources.size(); i++) {
+            needed[i] = resources[i].imported;
+        }
+
+        std::vector<bool> alive(passes.size(), false);
+        for (size_t p = passes.size(); p-- > 0;) {
+            bool writesNeeded = false;
+            bool writesAnything = false;
+            for (const auto& access : passes[p].accesses) {
+                if (!access.write) continue;
+                writesAnything = true;
+                writesNeeded = writesNeeded || needed[access.resource];
+            }
+            if (writesAnything && !writesNeeded) continue;
+
+            alive[p] = true;
+            for (const auto& access : passes[p].accesses) {
+                if (access.write && !resources[access.resource].imported) needed[access.resource] = false;
+            }
+            for (const auto& access : passes[p].accesses) {
+                if (!access.write) needed[access.resource] = true;
+            }
+        }
+
+        return alive;
+    }
+
+    std::vector<uint32_t> sortPasses(const std::vector<bool>& alive) const {
+        std::vector<std::vector<uint32_t>> successors(passes.size());
+        std::vector<uint32_t> predecessorCount(passes.size(), 0);
+
+        auto addEdge = [&](uint32_t from, uint32_t to) {
+            if (from == to) return;
+            successors[from].push_back(to);
+            predecessorCount[to]++;
+        };
+
+        for (uint32_t r = 0; r < resources.size(); r++) {
+            int64_t lastWriter = -1;
+            std::vector<uint32_t> readers;
+            for (uint32_t p = 0; p < passes.size(); p++) {
+                if (!alive[p]) continue;
+                for (const auto& access : passes[p].accesses) {
+                    if (access.resource != r) continue;
+                    if (lastWriter >= 0) addEdge(static_cast<uint32_t>(lastWriter), p);
+                    if (access.write) {
+                        for (uint32_t reader : readers) addEdge(reader, p);
+                        readers.clear();
+                        lastWriter = p;
+                    } else {
+                        readers.push_back(p);
+                    }
+                }
+            }
+        }
+
+        std::vector<uint32_t> order;
+        std::vector<bool> scheduled(passes.size(), false);
+        for (bool progress = true; progress;) {
+            progress = false;
+            for (uint32_t p = 0; p < passes.size(); p++) {
+                if (!alive[p] || scheduled[p] || predecessorCount[p] != 0) continue;
+                scheduled[p] = true;
+                order.push_back(p);
+                for (uint32_t successor : successors[p]) predecessorCount[successor]--;
+                progress = true;
+                break;
+            }
+        }
+
+        return order;
+    }
+
+    void retireTransientImages() {
+        if (transientMemory.empty()) return;
+
+        VkDevice device = this->device;
+        HostAllocator* hostAllocator = this->hostAllocator;
+        DeviceMemoryBudget* memoryBudget = this->memoryBudget;
+        std::vector<VkImage> images = std::move(transientImages);
+        std::vector<VkImageView> imageViews = std::move(transientImageViews);
+        std::vector<VkDeviceMemory> memory = std::move(transientMemory);
+        deletionQueue->push([device, hostAllocator, memoryBudget, images, imageViews, memory]() {
+            for (size_t i = 0; i < images.size(); i++) {
+                if (images[i] == VK_NULL_HANDLE) continue;
+                vkDestroyImageView(device, imageViews[i], hostAllocator->callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+                vkDestroyImage(device, images[i], hostAllocator->callbacks(VK_OBJECT_TYPE_IMAGE));
+            }
+            for (auto deviceMemory : memory) {
+                memoryBudget->free(deviceMemory);
+            }
+        });
+    }
+
+    // Transient images whose first..last pass ranges do not overlap are placed in the same allocation.
+    void allocateTransientImages(const std::vector<uint32_t>& order) {
+        firstUse.assign(resources.size(), UINT32_MAX);
+        lastUse.assign(resources.size(), 0);
+        for (uint32_t position = 0; position < order.size(); position++) {
+            for (const auto& access : passes[order[position]].accesses) {
+                firstUse[access.resource] = std::min(firstUse[access.resource], position);
+                lastUse[access.resource] = std::max(lastUse[access.resource], position);
+            }
+        }
+
+        transientImages.assign(resources.size(), VK_NULL_HANDLE);
+        transientImageViews.assign(resources.size(), VK_NULL_HANDLE);
+        aliasSlot.assign(resources.size(), UINT32_MAX);
+
+        std::vector<uint32_t> transients;
+        std::vector<VkMemoryRequirements> requirements(resources.size());
+        for (uint32_t r = 0; r < resources.size(); r++) {
+            if (resources[r].imported || firstUse[r] == UINT32_MAX) continue;
+            transients.push_back(r);
+
+            const RenderGraphImageDesc& desc = resources[r].desc;
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = {desc.extent.width, desc.extent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = desc.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = desc.usage;
+            imageInfo.samples = desc.samples;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (vkCreateImage(device, &imageInfo, hostAllocator->callbacks(VK_OBJECT_TYPE_IMAGE), &transientImages[r]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image!");
+            }
+            vkGetImageMemoryRequirements(device, transientImages[r], &requirements[r]);
+        }
+
+        std::sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) {
+            return firstUse[a] < firstUse[b];
+        });
+
+        struct Slot {
+            VkMemoryRequirements requirements;
+            VkImageUsageFlags usage;
+            uint32_t lastUse;
+        };
+        std::vector<Slot> slots;
+        transientImageCount = transients.size();
+        requestedBytes = 0;
+        allocatedBytes = 0;
+
+        for (uint32_t r : transients) {
+            requestedBytes += requirements[r].size;
+
+            VkImageUsageFlags transientUsage = resources[r].desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            for (uint32_t s = 0; s < slots.size(); s++) {
+                Slot& slot = slots[s];
+                if (slot.lastUse >= firstUse[r] || (slot.requirements.memoryTypeBits & requirements[r].memoryTypeBits) == 0 || (slot.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != transientUsage) continue;
+
+                slot.requirements.size = std::max(slot.requirements.size, requirements[r].size);
+                slot.requirements.alignment = std::max(slot.requirements.alignment, requirements[r].alignment);
+                slot.requirements.memoryTypeBits &= requirements[r].memoryTypeBits;
+                slot.usage |= resources[r].desc.usage;
+                slot.lastUse = lastUse[r];
+                aliasSlot[r] = s;
+                break;
+            }
+
+            if (aliasSlot[r] == UINT32_MAX) {
+                aliasSlot[r] = static_cast<uint32_t>(slots.size());
+                slots.push_back({requirements[r], resources[r].desc.usage, lastUse[r]});
+            }
+        }
+
+        for (const auto& slot : slots) {
+            transientMemory.push_back(allocateMemory(slot.requirements, slot.usage));
+            allocatedBytes += slot.requirements.size;
+        }
+
+        for (uint32_t r : transients) {
+            vkBindImageMemory(device, transientImages[r], transientMemory[aliasSlot[r]], 0);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = transientImages[r];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resources[r].desc.format;
+            viewInfo.subresourceRange = {resources[r].desc.aspect, 0, 1, 0, 1};
+
+            if (vkCreateImageView(device, &viewInfo, hostAllocator->callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &transientImageViews[r]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image view!");
+            }
+        }
+    }
+
+    bool transition(ResourceState& state, const AccessInfo& info, bool write, VkImageMemoryBarrier& barrier) const {
+        bool needed = state.layout != info.layout || state.writeAccess != 0 || (write && state.stages != 0);
+
+        if (needed) {
+            barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = state.writeAccess;
+            barrier.dstAccessMask = info.access;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = info.layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            state.stages = info.stages;
+        } else {
+            state.stages |= info.stages;
+        }
+
+        state.writeAccess = write ? info.access & WRITE_ACCESS : 0;
+        state.layout = info.layout;
+        return needed;
+    }
+
+    void addBarrier(BarrierBatch& batch, uint32_t resource, VkPipelineStageFlags srcStages, const AccessInfo& info, VkImageMemoryBarrier barrier) const {
+        barrier.subresourceRange = {resources[resource].desc.aspect, 0, 1, 0, 1};
+        batch.srcStages |= srcStages;
+        batch.dstStages |= info.stages;
+        batch.barriers.push_back({resource, srcStages, info.stages, barrier});
+    }
+
+    // The first use of a transient image discards its contents, so it only has to wait for the last use of the
+    // previous occupant of its allocation (or for itself in the previous frame). The first use of an imported image
+    // chains off the semaphore wait at the same stage.
+    void buildBarriers(const std::vector<uint32_t>& order) {
+        std::vector<ResourceState> finalStates(resources.size());
+        for (uint32_t p : order) {
+            for (const auto& access : passes[p].accesses) {
+                VkImageMemoryBarrier unused;
+                transition(finalStates[access.resource], accessInfo(access.access), access.write, unused);
+            }
+        }
+
+        std::vector<ResourceState> states(resources.size());
+        for (uint32_t r = 0; r < resources.size(); r++) {
+            if (resources[r].imported || aliasSlot[r] == UINT32_MAX) continue;
+
+            uint32_t previous = UINT32_MAX;
+            uint32_t last = r;
+            for (uint32_t other = 0; other < resources.size(); other++) {
+                if (aliasSlot[other] != aliasSlot[r]) continue;
+                if (lastUse[other] < firstUse[r] && (previous == UINT32_MAX || lastUse[other] > lastUse[previous])) previous = other;
+                if (lastUse[other] > lastUse[last]) last = other;
+            }
+            if (previous == UINT32_MAX) previous = last;
+            states[r].stages = finalStates[previous].stages;
+            states[r].writeAccess = finalStates[previous].writeAccess;
+        }
+
+        compiledPasses.clear();
+        firstAccessStages.assign(resources.size(), 0);
+        for (uint32_t p : order) {
+            CompiledPass compiledPass{p, {}};
+            for (const auto& access : passes[p].accesses) {
+                AccessInfo info = accessInfo(access.access);
+                ResourceState& state = states[access.resource];
+                if (firstAccessStages[access.resource] == 0) firstAccessStages[access.resource] = info.stages;
+                VkPipelineStageFlags srcStages = state.stages != 0 ? state.stages : info.stages;
+
+                VkImageMemoryBarrier barrier;
+                if (transition(state, info, access.write, barrier)) {
+                    addBarrier(compiledPass.barriers, access.resource, srcStages, info, barrier);
+                }
+            }
+            compiledPasses.push_back(std::move(compiledPass));
+        }
+
+        finalBarriers = {};
+        for (uint32_t r = 0; r < resources.size(); r++) {
+            if (!resources[r].imported || firstUse[r] == UINT32_MAX) continue;
+
+            AccessInfo info = accessInfo(resources[r].finalAccess);
+            VkPipelineStageFlags srcStages = states[r].stages;
+            VkImageMemoryBarrier barrier;
+            if (transition(states[r], info, false, barrier)) {
+                addBarrier(finalBarriers, r, srcStages, info, barrier);
+            }
+        }
+    }
+
+    void recordBarriers(VkCommandBuffer commandBuffer, BarrierBatch& batch) {
+        if (batch.barriers.empty()) return;
+
+        if (dispatch->cmdPipelineBarrier2 != nullptr) {
+            recordBarriers2(commandBuffer, batch);
+            return;
+        }
+
+        imageBarriers.clear();
+        for (auto& barrier : batch.barriers) {
+            barrier.barrier.image = resources[barrier.resource].imported ? resources[barrier.resource].image : transientImages[barrier.resource];
+            imageBarriers.push_back(barrier.barrier);
+        }
+
+        dispatch->cmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    }
+
+    // The legacy stage and access bits have the same values in their synchronization2 counterparts.
+    void recordBarriers2(VkCommandBuffer commandBuffer, BarrierBatch& batch) {
+        imageBarriers2.clear();
+        for (auto& barrier : batch.barriers) {
+            VkImageMemoryBarrier2 barrier2{};
+            barrier2.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            barrier2.srcStageMask = barrier.srcStages;
+            barrier2.srcAccessMask = barrier.barrier.srcAccessMask;
+            barrier2.dstStageMask = barrier.dstStages;
+            barrier2.dstAccessMask = barrier.barrier.dstAccessMask;
+            barrier2.oldLayout = barrier.barrier.oldLayout;
+            barrier2.newLayout = barrier.barrier.newLayout;
+            barrier2.srcQueueFamilyIndex = barrier.barrier.srcQueueFamilyIndex;
+            barrier2.dstQueueFamilyIndex = barrier.barrier.dstQueueFamilyIndex;
+            barrier2.image = resources[barrier.resource].imported ? resources[barrier.resource].image : transientImages[barrier.resource];
+            barrier2.subresourceRange = barrier.barrier.subresourceRange;
+            imageBarriers2.push_back(barrier2);
+        }
+
+        VkDependencyInfo dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers2.size());
+        dependencyInfo.pImageMemoryBarriers = imageBarriers2.data();
+        dispatch->cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    HostAllocator* hostAllocator = nullptr;
+    DeviceMemoryBudget* memoryBudget = nullptr;
+    DeletionQueue* deletionQueue = nullptr;
+    AllocateFunction allocateMemory;
+    const DeviceDispatch* dispatch = nullptr;
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+
+    bool compiled = false;
+    uint64_t compiledHash = 0;
+    size_t transientImageCount = 0;
+    VkDeviceSize requestedBytes = 0;
+    VkDeviceSize allocatedBytes = 0;
+    std::vector<uint32_t> firstUse;
+    std::vector<uint32_t> lastUse;
+    std::vector<uint32_t> aliasSlot;
+    std::vector<CompiledPass> compiledPasses;
+    std::vector<VkPipelineStageFlags> firstAccessStages;
+    BarrierBatch finalBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::vector<VkImageMemoryBarrier2> imageBarriers2;
+
+    std::vector<VkImage> transientImages;
+    std::vector<VkImageView> transientImageViews;
+    std::vector<VkDeviceMemory> transientMemory;
+};
+
+struct LoadedMip {
+    uint32_t texture;
+    uint32_t mipLevel;
+    std::vector<uint8_t> pixels;
+};
+
+// Produces mip levels on worker threads. There are no image assets in this project, so each level is
+// generated procedurally at its own resolution in place of reading and decoding it from disk.
+class TextureLoader {
+public:
+    void start(uint32_t threadCount) {
+        for (uint32_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+    void request(uint32_t texture, uint32_t mipLevel, uint32_t width, uint32_t height) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back({texture, mipLevel, width, height});
+        }
+        condition.notify_one();
+    }
+
+    void poll(std::vector<LoadedMip>& loaded) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& mip : completed) {
+            loaded.push_back(std::move(mip));
+        }
+        completed.clear();
+    }
+
+private:
+    struct Request {
+        uint32_t texture;
+        uint32_t mipLevel;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    void workerLoop() {
+        while (true) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !requests.empty(); });
+                if (stopping) return;
+
+                request = requests.front();
+                requests.pop_front();
+            }
+
+            LoadedMip mip{request.texture, request.mipLevel, generatePixels(request.texture, request.width, request.height)};
+
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.push_back(std::move(mip));
+        }
+    }
+
+    static std::vector<uint8_t> generatePixels(uint32_t texture, uint32_t width, uint32_t height) {
+        const uint8_t palette[][3] = {{230, 80, 60}, {60, 170, 230}, {90, 210, 90}, {240, 200, 60}};
+        const uint8_t* color = palette[texture % 4];
+
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                float shade = 0.6f;
+                if (width >= 16 && height >= 16) {
+                    shade = ((x * 8 / width + y * 8 / height) & 1) ? 1.0f : 0.2f;
+                }
+
+                uint8_t* pixel = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+                pixel[0] = static_cast<uint8_t>(color[0] * shade);
+                pixel[1] = static_cast<uint8_t>(color[1] * shade);
+                pixel[2] = static_cast<uint8_t>(color[2] * shade);
+                pixel[3] = 255;
+            }
+        }
+
+        return pixels;
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Request> requests;
+    std::vector<LoadedMip> completed;
+    bool stopping = false;
+};
+
+struct CaptureJob {
+    uint32_t slot;
+    const uint8_t* pixels;
+    uint32_t width;
+    uint32_t height;
+    bool swizzle;
+    uint64_t frameNumber;
+};
+
+struct CaptureStatistics {
+    uint64_t written = 0;
+    uint64_t failed = 0;
+    double convertMilliseconds = 0.0;
+    double encodeMilliseconds = 0.0;
+};
+
+// Converts and encodes captured frames on worker threads. A readback slot is handed back as soon as its pixels have
+// been converted, so the slower PNG encode and file write never hold up the ring.
+class CaptureWriter {
+public:
+    void start(uint32_t threadCount, SimdLevel simdLevel, const std::string& directory) {
+        this->simdLevel = simdLevel;
+        this->directory = directory;
+        stopping = false;
+        for (uint32_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    // Pending captures are still written before the workers exit.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+    void submit(const CaptureJob& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        condition.notify_one();
+    }
+
+    void poll(std::vector<uint32_t>& releasedSlots) {
+        std::lock_guard<std::mutex> lock(mutex);
+        releasedSlots.insert(releasedSlots.end(), released.begin(), released.end());
+        released.clear();
+    }
+
+    CaptureStatistics getStatistics() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return statistics;
+    }
+
+private:
+    void workerLoop() {
+        std::vector<uint8_t> rgba;
+        while (true) {
+            CaptureJob job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+
+                job = jobs.front();
+                jobs.pop_front();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            size_t pixelCount = static_cast<size_t>(job.width) * job.height;
+            rgba.resize(pixelCount * 4);
+            if (job.swizzle) {
+                convertBgraToRgba(simdLevel, job.pixels, rgba.data(), pixelCount);
+            } else {
+                std::memcpy(rgba.data(), job.pixels, rgba.size());
+            }
+            auto converted = std::chrono::steady_clock::now();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                released.push_back(job.slot);
+            }
+
+            std::ostringstream path;
+            path << directory << "/frame_" << std::setw(6) << std::setfill('0') << job.frameNumber << ".png";
+            bool written = writePng(path.str(), rgba.data(), job.width, job.height);
+            auto encoded = std::chrono::steady_clock::now();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            (written ? statistics.written : statistics.failed)++;
+            statistics.convertMilliseconds += std::chrono::duration<double, std::milli>(converted - start).count();
+            statistics.encodeMilliseconds += std::chrono::duration<double, std::milli>(encoded - converted).count();
+        }
+    }
+
+    SimdLevel simdLevel = SimdLevel::Scalar;
+    std::string directory;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<CaptureJob> jobs;
+    std::vector<uint32_t> released;
+    CaptureStatistics statistics;
+    bool stopping = false;
+};
+
+// Everything the render thread needs from the simulation for one frame. A packet is not modified once pushed.
+struct FramePacket {
+    uint64_t frameNumber = 0;
+    bool calibration = false;
+    bool captureRequested = false;
+    bool hasInput = false;
+    std::chrono::steady_clock::time_point frameStart;
+    std::chrono::steady_clock::time_point inputTime;
+    std::vector<uint32_t> changedInstances;
+    std::vector<TransformMatrix> changedTransforms;
+    std::vector<uint32_t> drawOrder;
+};
+
+// CPU time used by the calling thread alone, so blocking waits and other threads, such as texture loaders, are left out.
+double threadCpuSeconds() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// Lock-free single-producer, single-consumer ring between the main and render threads. Each side only writes its own
+// counter: the main thread publishes a filled slot with a release store to head, the render thread hands it back with
+// a release store to tail, and the acquire load on the other side makes the slot contents visible.
+class FramePacketQueue {
+public:
+    // Returns false once the queue has been closed.
+    bool waitForSpace() {
+        uint64_t index = head.load(std::memory_order_relaxed);
+        bool space = waitUntil([&]() { return index - tail.load(std::memory_order_acquire) < FRAME_PACKET_QUEUE_SIZE; });
+        return space && !closed.load(std::memory_order_acquire);
+    }
+
+    bool push(FramePacket& packet) {
+        if (!waitForSpace()) return false;
+
+        uint64_t index = head.load(std::memory_order_relaxed);
+        slots[index % FRAME_PACKET_QUEUE_SIZE] = std::move(packet);
+        head.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Packets pushed before close() are still handed out; false means the queue is closed and drained.
+    bool pop(FramePacket& packet) {
+        uint64_t index = tail.load(std::memory_order_relaxed);
+        if (!waitUntil([&]() { return head.load(std::memory_order_acquire) != index; })) return false;
+
+        packet = std::move(slots[index % FRAME_PACKET_QUEUE_SIZE]);
+        tail.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+    }
+
+private:
+    // Waits until ready() holds and returns true, or returns false once the queue is closed and ready() still fails.
+    // ready() is checked again after close is seen, so a packet pushed just before close() is not lost.
+    template<typename Predicate>
+    bool waitUntil(Predicate ready) {
+        for (uint32_t attempt = 0; !ready(); attempt++) {
+            if (closed.load(std::memory_order_acquire)) return ready();
+
+            if (attempt >= PACKET_QUEUE_SPINS + PACKET_QUEUE_YIELDS) {
+                std::this_thread::sleep_for(PACKET_QUEUE_SLEEP);
+            } else if (attempt >= PACKET_QUEUE_SPINS) {
+                std::this_thread::yield();
+            }
+        }
+        return true;
+    }
+
+    std::array<FramePacket, FRAME_PACKET_QUEUE_SIZE> slots;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<bool> closed{false};
+};
+
+// Closes the packet queue and joins the render thread however the main loop is left, so an exception on the main
+// thread never destroys a joinable std::thread.
+class RenderThreadGuard {
+public:
+    RenderThreadGuard(FramePacketQueue& packets, std::thread& thread) : packets(packets), thread(thread) {}
+    RenderThreadGuard(const RenderThreadGuard&) = delete;
+    RenderThreadGuard& operator=(const RenderThreadGuard&) = delete;
+
+    ~RenderThreadGuard() {
+        join();
+    }
+
+    void join() {
+        packets.close();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+private:
+    FramePacketQueue& packets;
+    std::thread& thread;
+};
+
+class LatencyHistogram {
+public:
+    void add(double milliseconds) {
+        size_t bucket = std::min<size_t>(static_cast<size_t>(std::max(0.0, milliseconds)), LATENCY_HISTOGRAM_BUCKETS - 1);
+        buckets[bucket]++;
+        count++;
+        total += milliseconds;
+        maximum = std::max(maximum, milliseconds);
+    }
+
+    // Upper edge of the bucket holding the given fraction of samples.
+    double percentile(double fraction) const {
+        uint64_t target = static_cast<uint64_t>(std::ceil(fraction * count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++) {
+            seen += buckets[i];
+            if (seen >= target) return static_cast<double>(i + 1);
+        }
+        return maximum;
+    }
+
+    void print(const std::string& name) const {
+        if (count == 0) return;
+
+        std::cout << name << " latency: " << count << " frames, mean " << total / count << " ms, p50 < " << percentile(0.5)
+                  << " ms, p99 < " << percentile(0.99) << " ms, max " << maximum << " ms" << std::endl;
+
+        uint64_t largest = *std::max_element(buckets.begin(), buckets.end());
+        for (size_t i = 0; i < buckets.size(); i++) {
+            if (buckets[i] == 0) continue;
+            std::cout << std::setw(4) << i << (i + 1 == buckets.size() ? "+ ms " : "  ms ") << std::string((buckets[i] * 50 + largest - 1) / largest, '#')
+                      << " " << buckets[i] << std::endl;
+        }
+    }
+
+private:
+    std::array<uint64_t, LATENCY_HISTOGRAM_BUCKETS> buckets{};
+    uint64_t count = 0;
+    double total = 0.0;
+    double maximum = 0.0;
+};
+
+struct PresentRecord {
+    uint64_t presentId;
+    std::chrono::steady_clock::time_point frameStart;
+    std::chrono::steady_clock::time_point inputTime;
+    bool hasInput;
+};
+
+// Waits for each tagged present on its own thread so the render thread never blocks on the display. The time
+// vkWaitForPresentKHR returns is taken as the moment the frame reached the screen.
+class PresentMonitor {
+public:
+    void start(VkDevice device, VkSwapchainKHR swapChain, PFN_vkWaitForPresentKHR waitForPresent) {
+        this->device = device;
+        this->swapChain = swapChain;
+        this->waitForPresent = waitForPresent;
+        stopping = false;
+        worker = std::thread([this]() { monitorLoop(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    void submit(const PresentRecord& record) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            records.push_back(record);
+        }
+        condition.notify_one();
+    }
+
+    double getPaceDelayMilliseconds() const {
+        return paceDelayMilliseconds;
+    }
+
+    // Only valid once stop() has returned.
+    void report() const {
+        frameLatency.print("frame start to present");
+        inputLatency.print("input to present");
+        std::cout << "present: refresh period " << refreshPeriodMilliseconds << " ms, " << missedFrames << " missed vblanks, "
+                  << failedWaits << " failed waits, pace delay " << paceDelayMilliseconds << " ms" << std::endl;
+    }
+
+private:
+    void monitorLoop() {
+        while (true) {
+            PresentRecord record;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !records.empty(); });
+                if (records.empty()) return;
+
+                record = records.front();
+                records.pop_front();
+            }
+
+            VkResult result;
+            do {
+                result = waitForPresent(device, swapChain, record.presentId, PRESENT_WAIT_TIMEOUT);
+            } while (result == VK_TIMEOUT && !isStopping());
+
+            if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                failedWaits++;
+                continue;
+            }
+
+            auto presented = std::chrono::steady_clock::now();
+            frameLatency.add(std::chrono::duration<double, std::milli>(presented - record.frameStart).count());
+            if (record.hasInput) {
+                inputLatency.add(std::chrono::duration<double, std::milli>(presented - record.inputTime).count());
+            }
+
+            if (record.presentId > 1 && lastPresentId == record.presentId - 1) {
+                updatePacing(std::chrono::duration<double, std::milli>(presented - lastPresentTime).count());
+            }
+            lastPresentId = record.presentId;
+            lastPresentTime = presented;
+        }
+    }
+
+    // Intervals under a millisecond mean the wait returned late for an earlier frame and say nothing about vblank.
+    void updatePacing(double interval) {
+        if (interval < 1.0) return;
+
+        refreshPeriodMilliseconds = refreshPeriodMilliseconds == 0.0 ? interval : std::min(refreshPeriodMilliseconds, interval);
+        double delay = paceDelayMilliseconds;
+        if (interval > refreshPeriodMilliseconds * 1.5) {
+            missedFrames++;
+            delay *= 0.5;
+        } else {
+            delay = std::min(delay + PACE_STEP_MILLISECONDS, refreshPeriodMilliseconds * 0.9);
+        }
+        paceDelayMilliseconds = delay;
+    }
+
+    bool isStopping() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stopping;
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<PresentRecord> records;
+    bool stopping = false;
+
+    LatencyHistogram frameLatency;
+    LatencyHistogram inputLatency;
+    uint64_t lastPresentId = 0;
+    std::chrono::steady_clock::time_point lastPresentTime;
+    double refreshPeriodMilliseconds = 0.0;
+    std::atomic<double> paceDelayMilliseconds{0.0};
+    uint64_t missedFrames = 0;
+    uint64_t failedWaits = 0;
+};
+
+struct MeshData {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texCoords;
+    std::vector<uint32_t> indices;
+
+    size_t vertexCount() const {
+        return positions.size() / 3;
+    }
+};
+
+// Positions are normalized into the [-1, 1] box so they can be stored as SNORM without extra dequantization constants.
+void normalizeMesh(MeshData& mesh) {
+    float minimum[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float maximum[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+    for (size_t i = 0; i < mesh.positions.size(); i++) {
+        minimum[i % 3] = std::min(minimum[i % 3], mesh.positions[i]);
+        maximum[i % 3] = std::max(maximum[i % 3], mesh.positions[i]);
+    }
+
+    float extent = std::max({maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2]}) * 0.5f;
+    if (extent <= 0.0f) extent = 1.0f;
+
+    for (size_t i = 0; i < mesh.positions.size(); i++) {
+        float center = (minimum[i % 3] + maximum[i % 3]) * 0.5f;
+        mesh.positions[i] = (mesh.positions[i] - center) / extent;
+    }
+}
+
+void computeNormals(MeshData& mesh) {
+    mesh.normals.assign(mesh.positions.size(), 0.0f);
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        const float* a = &mesh.positions[mesh.indices[i] * 3];
+        const float* b = &mesh.positions[mesh.indices[i + 1] * 3];
+        const float* c = &mesh.positions[mesh.indices[i + 2] * 3];
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            for (size_t axis = 0; axis < 3; axis++) {
+                mesh.normals[mesh.indices[i + corner] * 3 + axis] += normal[axis];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < mesh.normals.size(); i += 3) {
+        float length = std::sqrt(mesh.normals[i] * mesh.normals[i] + mesh.normals[i + 1] * mesh.normals[i + 1] + mesh.normals[i + 2] * mesh.normals[i + 2]);
+        for (size_t axis = 0; axis < 3; axis++) {
+            mesh.normals[i + axis] = length > 0.0f ? mesh.normals[i + axis] / length : (axis == 2 ? 1.0f : 0.0f);
+        }
+    }
+}
+
+bool loadObj(const std::string& filename, MeshData& mesh) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::vector<float> positions;
+    std::vector<float> texCoords;
+    std::vector<float> normals;
+    std::map<std::array<int64_t, 3>, uint32_t> uniqueVertices;
+
+    // OBJ indices are 1-based, or relative to the end of the list when negative; anything else is rejected.
+    auto resolveIndex = [&filename](const std::string& value, size_t count) -> int64_t {
+        size_t parsed = 0;
+        int64_t index = 0;
+        try {
+            index = std::stoll(value, &parsed);
+        } catch (const std::exception&) {
+            parsed = 0;
+        }
+
+        int64_t resolved = index < 0 ? static_cast<int64_t>(count) + index : index - 1;
+        if (parsed != value.size() || index == 0 || resolved < 0 || resolved >= static_cast<int64_t>(count)) {
+            throw std::runtime_error("invalid face index " + value + " in " + filename + "!");
+        }
+        return resolved;
+    };
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+
+        if (type == "v") {
+            float x, y, z;
+            stream >> x >> y >> z;
+            positions.insert(positions.end(), {x, y, z});
+        } else if (type == "vt") {
+            float u, v;
+            stream >> u >> v;
+            texCoords.insert(texCoords.end(), {u, 1.0f - v});
+        } else if (type == "vn") {
+            float x, y, z;
+            stream >> x >> y >> z;
+            normals.insert(normals.end(), {x, y, z});
+        } else if (type == "f") {
+            std::vector<uint32_t> face;
+            std::string corner;
+            while (stream >> corner) {
+                std::array<int64_t, 3> key = {-1, -1, -1};
+                size_t start = 0;
+                for (size_t component = 0; component < 3 && start <= corner.size(); component++) {
+                    size_t end = corner.find('/', start);
+                    std::string value = corner.substr(start, end == std::string::npos ? std::string::npos : end - start);
+                    if (!value.empty()) {
+                        size_t count = component == 0 ? positions.size() / 3 : component == 1 ? texCoords.size() / 2 : normals.size() / 3;
+                        key[component] = resolveIndex(value, count);
+                    }
+                    if (end == std::string::npos) break;
+                    start = end + 1;
+                }
+
+                if (key[0] < 0) {
+                    throw std::runtime_error("face corner " + corner + " without a position in " + filename + "!");
+                }
+
+                auto inserted = uniqueVertices.emplace(key, static_cast<uint32_t>(mesh.positions.size() / 3));
+                if (inserted.second) {
+                    mesh.positions.insert(mesh.positions.end(), &positions[key[0] * 3], &positions[key[0] * 3] + 3);
+                    if (key[1] >= 0) {
+                        mesh.texCoords.insert(mesh.texCoords.end(), &texCoords[key[1] * 2], &texCoords[key[1] * 2] + 2);
+                    } else {
+                        mesh.texCoords.insert(mesh.texCoords.end(), {0.0f, 0.0f});
+                    }
+                    if (key[2] >= 0) {
+                        mesh.normals.insert(mesh.normals.end(), &normals[key[2] * 3], &normals[key[2] * 3] + 3);
+                    }
+                }
+                face.push_back(inserted.first->second);
+            }
+
+            for (size_t i = 2; i < face.size(); i++) {
+                mesh.indices.insert(mesh.indices.end(), {face[0], face[i - 1], face[i]});
+            }
+        }
+    }
+
+    if (mesh.indices.empty()) {
+        throw std::runtime_error("failed to load mesh " + filename + "!");
+    }
+
+    if (mesh.normals.size() != mesh.positions.size()) {
+        computeNormals(mesh);
+    }
+    normalizeMesh(mesh);
+    return true;
+}
+
+MeshData generateSphere(uint32_t rings, uint32_t segments) {
+    MeshData mesh;
+    const float pi = 3.14159265358979f;
+
+    for (uint32_t ring = 0; ring <= rings; ring++) {
+        float theta = pi * ring / rings;
+        for (uint32_t segment = 0; segment <= segments; segment++) {
+            float phi = 2.0f * pi * segment / segments;
+            float normal[3] = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+            mesh.positions.insert(mesh.positions.end(), normal, normal + 3);
+            mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+            mesh.texCoords.insert(mesh.texCoords.end(), {static_cast<float>(segment) / segments * 4.0f, static_cast<float>(ring) / rings * 2.0f});
+        }
+    }
+
+    for (uint32_t ring = 0; ring < rings; ring++) {
+        for (uint32_t segment = 0; segment < segments; segment++) {
+            uint32_t a = ring * (segments + 1) + segment;
+            uint32_t b = a + segments + 1;
+            mesh.indices.insert(mesh.indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+        }
+    }
+
+    return mesh;
+}
+
+// Average cache miss ratio: transformed vertices per triangle for a FIFO post-transform cache.
+float computeAcmr(const std::vector<uint32_t>& indices, size_t cacheSize) {
+    std::vector<uint32_t> cache(cacheSize, UINT32_MAX);
+    size_t head = 0;
+    size_t misses = 0;
+
+    for (uint32_t index : indices) {
+        if (std::find(cache.begin(), cache.end(), index) == cache.end()) {
+            cache[head] = index;
+            head = (head + 1) % cacheSize;
+            misses++;
+        }
+    }
+
+    return indices.empty() ? 0.0f : static_cast<float>(misses) / (indices.size() / 3);
+}
+
+// Tom Forsyth's linear-speed vertex cache optimisation: greedily emits the triangle with the best score, where
+// vertices score higher the more recently they were used and the fewer unemitted triangles still reference them.
+std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount) {
+    const int cacheSize = 32;
+    auto vertexScore = [](int cachePosition, uint32_t remaining) {
+        if (remaining == 0) return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            score = cachePosition < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(cachePosition - 3) / (cacheSize - 3), 1.5f);
+        }
+        return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+    };
+
+    size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices) {
+        remaining[index]++;
+    }
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        scores[v] = vertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    int64_t best = -1;
+
+    while (result.size() < indices.size()) {
+        if (best < 0) {
+            for (size_t t = 0; t < triangleCount; t++) {
+                if (!emitted[t] && (best < 0 || triangleScores[t] > triangleScores[best])) best = static_cast<int64_t>(t);
+            }
+        }
+
+        const uint32_t* triangle = &indices[best * 3];
+        emitted[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t v = triangle[corner];
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + remaining[v];
+            *std::find(begin, end, static_cast<uint32_t>(best)) = *(end - 1);
+            remaining[v]--;
+        }
+
+        nextCache.assign(triangle, triangle + 3);
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) nextCache.push_back(v);
+        }
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            cachePositions[nextCache[i]] = i < static_cast<size_t>(cacheSize) ? static_cast<int>(i) : -1;
+            scores[nextCache[i]] = vertexScore(cachePositions[nextCache[i]], remaining[nextCache[i]]);
+        }
+        if (nextCache.size() > static_cast<size_t>(cacheSize)) nextCache.resize(cacheSize);
+        std::swap(cache, nextCache);
+
+        best = -1;
+        for (uint32_t v : cache) {
+            for (uint32_t i = 0; i < remaining[v]; i++) {
+                uint32_t t = adjacency[offsets[v] + i];
+                triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                if (best < 0 || triangleScores[t] > triangleScores[best]) best = t;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Renumbers vertices in the order the index buffer first references them, so vertex fetch walks memory forward.
+void optimizeVertexFetch(MeshData& mesh) {
+    std::vector<uint32_t> remap(mesh.vertexCount(), UINT32_MAX);
+    MeshData reordered;
+    reordered.indices.reserve(mesh.indices.size());
+
+    for (uint32_t index : mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(reordered.vertexCount());
+            reordered.positions.insert(reordered.positions.end(), &mesh.positions[index * 3], &mesh.positions[index * 3] + 3);
+            reordered.normals.insert(reordered.normals.end(), &mesh.normals[index * 3], &mesh.normals[index * 3] + 3);
+            reordered.texCoords.insert(reordered.texCoords.end(), &mesh.texCoords[index * 2], &mesh.texCoords[index * 2] + 2);
+        }
+        reordered.indices.push_back(remap[index]);
+    }
+
+    mesh = std::move(reordered);
+}
+
+// Rounds to nearest even like a hardware conversion, including subnormal results.
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7fffffff;
+
+    if (magnitude > 0x7f800000) return static_cast<uint16_t>(sign | 0x7e00);
+    if (magnitude >= 0x477ff000) return static_cast<uint16_t>(sign | 0x7c00);
+
+    uint32_t half;
+    uint32_t rest;
+    uint32_t halfway;
+    if (magnitude >= 0x38800000) {
+        half = (magnitude - 0x38000000) >> 13;
+        rest = magnitude & 0x1fff;
+        halfway = 0x1000;
+    } else {
+        uint32_t exponent = magnitude >> 23;
+        if (exponent < 102) return static_cast<uint16_t>(sign);
+
+        uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - exponent;
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    }
+
+    if (rest > halfway || (rest == halfway && (half & 1))) half++;
+    return static_cast<uint16_t>(sign | half);
+}
+
+int16_t quantizeSnorm16(float value) {
+    return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+std::vector<Vertex> quantizeVertices(const MeshData& mesh) {
+    std::vector<Vertex> vertices(mesh.vertexCount());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const float* position = &mesh.positions[i * 3];
+        const float* normal = &mesh.normals[i * 3];
+        const float* texCoord = &mesh.texCoords[i * 2];
+
+        for (size_t axis = 0; axis < 3; axis++) {
+            vertices[i].position[axis] = quantizeSnorm16(position[axis]);
+        }
+        vertices[i].position[3] = 0;
+
+        float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+        float x = normal[0] / length;
+        float y = normal[1] / length;
+        if (normal[2] < 0.0f) {
+            float wrappedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float wrappedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = wrappedX;
+            y = wrappedY;
+        }
+        vertices[i].normal[0] = quantizeSnorm16(x);
+        vertices[i].normal[1] = quantizeSnorm16(y);
+
+        vertices[i].texCoord[0] = floatToHalf(texCoord[0]);
+        vertices[i].texCoord[1] = floatToHalf(texCoord[1]);
+    }
+
+    return vertices;
+}
+
+const std::vector<std::pair<VkPresentModeKHR, std::string>> PRESENT_MODE_NAMES = {
+    {VK_PRESENT_MODE_IMMEDIATE_KHR, "immediate"},
+    {VK_PRESENT_MODE_MAILBOX_KHR, "mailbox"},
+    {VK_PRESENT_MODE_FIFO_KHR, "fifo"},
+    {VK_PRESENT_MODE_FIFO_RELAXED_KHR, "fifo_relaxed"}
+};
+
+std::string presentModeName(VkPresentModeKHR presentMode) {
+    for (const auto& [mode, name] : PRESENT_MODE_NAMES) {
+        if (mode == presentMode) return name;
+    }
+    return std::to_string(presentMode);
+}
+
+VkPresentModeKHR parsePresentMode(const std::string& name) {
+    for (const auto& [mode, modeName] : PRESENT_MODE_NAMES) {
+        if (modeName == name) return mode;
+    }
+    throw std::runtime_error("unknown present mode: " + name);
+}
+
+// Frame loop settings. The swap chain asks for extraSwapChainImages images beyond the surface's minimum, so a saved
+// configuration stays meaningful on surfaces with a different minimum. Without GPU-driven rendering, draws are sorted
+// and recorded on the CPU.
+struct FrameConfig {
+    uint32_t width = WIDTH;
+    uint32_t height = HEIGHT;
+    uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    uint32_t extraSwapChainImages = 1;
+    bool gpuDrivenRendering = GPU_DRIVEN_RENDERING;
+
+    bool operator==(const FrameConfig& other) const {
+        return width == other.width && height == other.height && framesInFlight == other.framesInFlight && presentMode == other.presentMode &&
+            extraSwapChainImages == other.extraSwapChainImages && gpuDrivenRendering == other.gpuDrivenRendering;
+    }
+
+    void setFramesInFlight(uint32_t count) {
+        if (count == 0 || count > MAX_FRAMES_IN_FLIGHT) {
+            throw std::runtime_error("frames in flight must be between 1 and " + std::to_string(MAX_FRAMES_IN_FLIGHT) + "!");
+        }
+        framesInFlight = count;
+    }
+
+    void setRecording(const std::string& recording) {
+        if (recording != "gpu" && recording != "cpu") {
+            throw std::runtime_error("unknown recording strategy: " + recording);
+        }
+        gpuDrivenRendering = recording == "gpu";
+    }
+
+    std::string describe() const {
+        std::ostringstream description;
+        description << width << "x" << height << ", " << framesInFlight << " frames in flight, " << presentModeName(presentMode) << ", "
+                    << extraSwapChainImages << " extra images, " << (gpuDrivenRendering ? "gpu" : "cpu") << " recording";
+        return description.str();
+    }
+};
+
+// The file holds one "key value" pair per line, in the format written by saveFrameConfig.
+bool loadFrameConfig(const std::string& path, FrameConfig& config) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string key, value;
+    while (file >> key >> value) {
+        if (key == "width") {
+            config.width = static_cast<uint32_t>(std::stoul(value));
+        } else if (key == "height") {
+            config.height = static_cast<uint32_t>(std::stoul(value));
+        } else if (key == "frames_in_flight") {
+            config.setFramesInFlight(static_cast<uint32_t>(std::stoul(value)));
+        } else if (key == "present_mode") {
+            config.presentMode = parsePresentMode(value);
+        } else if (key == "extra_swap_chain_images") {
+            config.extraSwapChainImages = static_cast<uint32_t>(std::stoul(value));
+        } else if (key == "recording") {
+            config.setRecording(value);
+        } else {
+            throw std::runtime_error("unknown frame config key in " + path + ": " + key);
+        }
+    }
+
+    return true;
+}
+
+void saveFrameConfig(const std::string& path, const FrameConfig& config) {
+    std::ofstream file(path);
+    file << "width " << config.width << "\n"
+         << "height " << config.height << "\n"
+         << "frames_in_flight " << config.framesInFlight << "\n"
+         << "present_mode " << presentModeName(config.presentMode) << "\n"
+         << "extra_swap_chain_images " << config.extraSwapChainImages << "\n"
+         << "recording " << (config.gpuDrivenRendering ? "gpu" : "cpu") << "\n";
+    if (!file) {
+        throw std::runtime_error("failed to write " + path + "!");
+    }
+}
+
+struct RunOptions {
+    FrameConfig frameConfig;
+    std::string configPath = FRAME_CONFIG_PATH;
+    bool autoTune = false;
+    bool calibrateDepthSort = false;
+    bool dispatchBenchmark = false;
+    std::set<uint64_t> captureFrames;
+    std::string captureDirectory = CAPTURE_DIRECTORY;
+    uint64_t frameLimit = 0;
+    bool deterministic = false;
+    bool onDemand = false;
+    bool adaptivePacing = false;
+    double frameBudgetMilliseconds = 0.0;
+    double targetGpuMilliseconds = 0.0;
+};
+
+// Options used to drive the renderer from scripts, e.g. on a software ICD:
+//   --frames N           exit after N frames
+//   --capture A,B,...    capture these frame numbers into CAPTURE_DIRECTORY
+//   --capture-dir PATH   write captures to PATH instead of CAPTURE_DIRECTORY
+//   --deterministic      fixed 60 Hz timestep and fully streamed textures before the first frame; ignores
+//                        FRAME_CONFIG_PATH, so the run only depends on its command line
+//   --frame-budget MS    fail if the 95th percentile frame time exceeds MS milliseconds
+//   --on-demand          only render when input, animation or streaming changes the image; starts paused, space toggles animation
+//   --pace               delay the start of each frame as long as frames still make their vblank
+//   --target-gpu-ms MS   scale the render resolution to keep GPU frame time near MS milliseconds
+//   --calibrate-depth-sort draw frame DEPTH_SORT_CALIBRATION_FRAME back to front and report the early-Z savings
+//   --dispatch-benchmark time draw recording through the loader and through the device dispatch table, then exit
+// Frame settings, which override those read from the config file:
+//   --config PATH            read frame settings from PATH instead of FRAME_CONFIG_PATH
+//   --width W, --height H    window size
+//   --frames-in-flight N     frames the CPU may record ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT
+//   --present-mode MODE      immediate, mailbox, fifo or fifo_relaxed; falls back to fifo when unsupported
+//   --extra-images N         swap chain images beyond the surface's minimum
+//   --recording gpu|cpu      GPU-driven culling and indirect draws, or CPU-sorted draws
+//   --auto-tune              benchmark frame settings on this machine, save the fastest to the config file and exit
+RunOptions parseRunOptions(int argc, char* argv[]) {
+    RunOptions options;
+    bool explicitConfig = false;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--config" && i + 1 < argc) {
+            options.configPath = argv[i + 1];
+            explicitConfig = true;
+        } else if (option == "--deterministic") {
+            options.deterministic = true;
+        }
+    }
+    if ((explicitConfig || !options.deterministic) && loadFrameConfig(options.configPath, options.frameConfig)) {
+        std::cout << "frame settings from " << options.configPath << ": " << options.frameConfig.describe() << std::endl;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (option == "--config" && hasValue) {
+            i++;
+        } else if (option == "--width" && hasValue) {
+            options.frameConfig.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (option == "--height" && hasValue) {
+            options.frameConfig.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (option == "--frames-in-flight" && hasValue) {
+            options.frameConfig.setFramesInFlight(static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (option == "--present-mode" && hasValue) {
+            options.frameConfig.presentMode = parsePresentMode(argv[++i]);
+        } else if (option == "--extra-images" && hasValue) {
+            options.frameConfig.extraSwapChainImages = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (option == "--recording" && hasValue) {
+            options.frameConfig.setRecording(argv[++i]);
+        } else if (option == "--auto-tune") {
+            options.autoTune = true;
+        } else if (option == "--calibrate-depth-sort") {
+            options.calibrateDepthSort = true;
+        } else if (option == "--dispatch-benchmark") {
+            options.dispatchBenchmark = true;
+        } else if (option == "--deterministic") {
+            options.deterministic = true;
+        } else if (option == "--on-demand") {
+            options.onDemand = true;
+        } else if (option == "--pace") {
+            options.adaptivePacing = true;
+        } else if (option == "--frames" && hasValue) {
+            options.frameLimit = std::stoull(argv[++i]);
+        } else if (option == "--capture" && hasValue) {
+            std::istringstream frames(argv[++i]);
+            std::string frame;
+            while (std::getline(frames, frame, ',')) {
+                options.captureFrames.insert(std::stoull(frame));
+            }
+        } else if (option == "--capture-dir" && hasValue) {
+            options.captureDirectory = argv[++i];
+        } else if (option == "--frame-budget" && hasValue) {
+            options.frameBudgetMilliseconds = std::stod(argv[++i]);
+        } else if (option == "--target-gpu-ms" && hasValue) {
+            options.targetGpuMilliseconds = std::stod(argv[++i]);
+        } else {
+            throw std::runtime_error("unknown option: " + option);
+        }
+    }
+
+    return options;
+}
+
+class HelloTriangleApplication {
+public:
+    void run(const RunOptions& options) {
+        this->options = options;
+        frameConfig = options.frameConfig;
+
+        {
+            ProfileScope startupScope(startupProfiler, "startup");
+            initWindow();
+            initVulkan();
+        }
+        reportStartupProfile();
+
+        if (options.dispatchBenchmark) {
+            benchmarkDispatch();
+        } else {
+            mainLoop();
+        }
+        cleanup();
+        checkFrameBudget();
+    }
+
+    // The settings the run actually used, after falling back from whatever the device or surface does not support.
+    const FrameConfig& getFrameConfig() const {
+        return frameConfig;
+    }
+
+    double getMeanFrameMilliseconds() const {
+        std::vector<double> measured = measuredFrameTimes();
+        return measured.empty() ? 0.0 : std::accumulate(measured.begin(), measured.end(), 0.0) / measured.size();
+    }
+
+private:
+    std::vector<RenderWindow> windows;
+
+    VkInstance instance;
+    VkDebugUtilsMessengerEXT debugMessenger;
+    PFN_vkDestroyDebugUtilsMessengerEXT destroyDebugUtilsMessenger = nullptr;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkFormat depthFormat;
+    bool pipelineStatisticsSupported = false;
+    VkDevice device;
+
+    VkQueue graphicsQueue;
+    VkQueue presentQueue;
+    VkQueue transferQueue;
+
+    HostAllocator hostAllocator;
+    DeviceMemoryBudget memoryBudget;
+    bool memoryBudgetSupported = false;
+    DeletionQueue deletionQueue;
+    RenderGraph renderGraph;
+
+    VkRenderPass renderPass;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorSetLayout cullDescriptorSetLayout;
+    DeferredHandle<VkPipelineLayout> pipelineLayout;
+    DeferredHandle<VkPipeline> graphicsPipeline;
+    DeferredHandle<VkPipeline> depthPrepassPipeline;
+    DeferredHandle<VkPipelineLayout> cullPipelineLayout;
+    DeferredHandle<VkPipeline> cullPipeline;
+
+    bool gpuDrivenRendering = false;
+    bool drawIndirectCountSupported = false;
+    bool dynamicResolution = false;
+    VkFilter upscaleFilter = VK_FILTER_LINEAR;
+    double resolutionScale = 1.0;
+    double smoothedGpuMilliseconds = 0.0;
+    double resolutionScaleTotal = 0.0;
+    uint64_t resolutionScaleSamples = 0;
+    bool presentWaitSupported = false;
+    PresentMonitor presentMonitor;
+    bool synchronization2Supported = false;
+    DeviceDispatch dispatch;
+    QueueSubmitter queueSubmitter;
+
+    VkCommandPool transferCommandPool;
+    VkDescriptorPool descriptorPool;
+    std::vector<VkDescriptorSet> descriptorSets;
+    std::vector<uint64_t> descriptorSetVersions;
+    VkSampler textureSampler;
+    VkImage placeholderImage;
+    VkDeviceMemory placeholderImageMemory;
+    VkImageView placeholderImageView;
+
+    TextureLoader textureLoader;
+
+    std::vector<CaptureSlot> captureSlots;
+    CaptureWriter captureWriter;
+    bool captureSupported = false;
+    bool captureSwizzle = false;
+    bool captureMemoryCoherent = true;
+    bool captureRequested = false;
+    bool captureRequestPending = false;
+    uint32_t activeCaptureSlot = UINT32_MAX;
+    std::vector<uint32_t> releasedCaptureSlots;
+    uint64_t droppedCaptures = 0;
+    double captureCpuMilliseconds = 0.0;
+    double frameMilliseconds = 0.0;
+    std::chrono::steady_clock::time_point lastFrameTime;
+    std::vector<double> frameTimes;
+
+    FramePacketQueue framePackets;
+    std::thread renderThread;
+    std::exception_ptr renderError;
+    std::atomic<bool> renderWorkPending{true};
+    uint64_t simulationFrameNumber = 0;
+
+    bool frameDirty = true;
+    bool inputPending = false;
+    std::chrono::steady_clock::time_point inputTime;
+    bool animationPaused = false;
+    std::chrono::steady_clock::time_point animationPauseTime;
+    double gpuBusyMilliseconds = 0.0;
+    double simulationCpuSeconds = 0.0;
+    double renderCpuSeconds = 0.0;
+
+    RunOptions options;
+    FrameConfig frameConfig;
+    std::vector<StreamedTexture> textures;
+    std::vector<TextureUpload> textureUploads;
+    std::vector<VkSemaphore> textureUploadSemaphores;
+    std::vector<LoadedMip> loadedMips;
+    VkDeviceSize textureResidentBytes = 0;
+    VkDeviceSize textureRetiringBytes = 0;
+    VkDeviceSize textureBudget = TEXTURE_BUDGET;
+    std::map<VkFence, uint32_t> textureUploadFenceUses;
+    uint64_t textureVersion = 1;
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    VkBuffer vertexBuffer;
+    VkDeviceMemory vertexBufferMemory;
+    VkBuffer indexBuffer;
+    VkDeviceMemory indexBufferMemory;
+    VkIndexType indexType;
+
+    std::vector<SceneObject> sceneObjects;
+    VkBuffer objectBuffer;
+    VkDeviceMemory objectBufferMemory;
+    std::vector<VkBuffer> drawCommandBuffers;
+    std::vector<VkDeviceMemory> drawCommandBuffersMemory;
+    std::vector<VkBuffer> drawCountBuffers;
+    std::vector<VkDeviceMemory> drawCountBuffersMemory;
+    std::vector<VkDescriptorSet> cullDescriptorSets;
+    std::vector<uint32_t> drawOrder;
+    std::vector<uint32_t> sortedDrawOrder;
+    bool drawOrderSorted = false;
+    BoundingVolumes objectBounds;
+    FrustumPlanes clipPlanes;
+    SimdLevel simdLevel;
+    InstanceTransforms objectTransforms;
+    TransformHierarchy sceneHierarchy;
+    std::vector<uint32_t> objectNodes;
+    std::vector<uint32_t> groupNodes;
+    std::vector<std::array<float, 2>> groupCenters;
+    std::chrono::steady_clock::time_point sceneStartTime;
+    std::vector<TransformMatrix> instanceWorlds;
+    std::vector<VkBuffer> instanceBuffers;
+    std::vector<VkDeviceMemory> instanceBuffersMemory;
+    std::vector<void*> instanceBuffersMapped;
+    std::vector<std::vector<uint32_t>> pendingInstanceUploads;
+    std::vector<std::vector<uint8_t>> instanceUploadQueued;
+
+    GpuProfiler gpuProfiler;
+    std::vector<bool> inFlightCalibration;
+    uint64_t frontToBackInvocations = 0;
+
+    VkCommandPool commandPool;
+    std::vector<VkCommandBuffer> commandBuffers;
+
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+    std::vector<VkFence> inFlightFences;
+    std::vector<uint64_t> inFlightFrameNumbers;
+    uint32_t currentFrame = 0;
+    uint64_t frameNumber = 0;
+
+    StartupProfiler startupProfiler;
+
+    void initWindow() {
+        ProfileScope scope(startupProfiler, "initWindow");
+
+        {
+            ProfileScope glfwScope(startupProfiler, "glfwInit");
+            glfwInit();
+        }
+
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+
+        ProfileScope windowScope(startupProfiler, "glfwCreateWindow");
+        windows.resize(WINDOW_COUNT);
+        for (uint32_t i = 0; i < WINDOW_COUNT; i++) {
+            std::string title = WINDOW_COUNT > 1 ? "Vulkan " + std::to_string(i + 1) : "Vulkan";
+            windows[i].window = glfwCreateWindow(frameConfig.width, frameConfig.height, title.c_str(), nullptr, nullptr);
+        }
+    }
+
+    void initVulkan() {
+        ProfileScope scope(startupProfiler, "initVulkan");
+
+        createInstance();
+        setupDebugMessenger();
+        createSurfaces();
+        pickPhysicalDevice();
+        createLogicalDevice();
+        createSwapChains();
+        createImageViews();
+        createDynamicResolution();
+        createRenderPass();
+        createDescriptorSetLayout();
+        createGraphicsPipeline();
+        createCullPipeline();
+        createRenderGraph();
+        createFramebuffers();
+        createCommandPool();
+        createTextureStreaming();
+        loadModel();
+        createVertexBuffer();
+        createIndexBuffer();
+        createScene();
+        createObjectBuffer();
+        createDrawCommandBuffers();
+        createInstanceBuffers();
+        createDescriptorPool();
+        createDescriptorSets();
+        createCommandBuffers();
+        createSyncObjects();
+        createGpuProfiler();
+        createInputCallbacks();
+        createCaptureResources();
+        createPresentMonitor();
+    }
+
+    void mainLoop() {
+        if (options.deterministic) {
+            waitForTextureResidency();
+        }
+
+        // An animated scene is never static, so on-demand runs start paused and space starts the animation.
+        if (options.onDemand && !options.deterministic) {
+            toggleAnimation();
+        }
+
+        lastFrameTime = std::chrono::steady_clock::now();
+        auto loopStart = lastFrameTime;
+        std::clock_t cpuStart = std::clock();
+
+        // The main thread handles events and the simulation while the render thread records and submits, so
+        // building frame N + 1 overlaps with rendering frame N.
+        renderThread = std::thread([this]() { renderLoop(); });
+        RenderThreadGuard renderThreadGuard(framePackets, renderThread);
+
+        while (!windowShouldClose() && (options.frameLimit == 0 || simulationFrameNumber < options.frameLimit)) {
+            if (options.onDemand && !needsRedraw()) {
+                glfwWaitEventsTimeout(ON_DEMAND_WAIT_SECONDS);
+                // Input that left the image unchanged is not shown by any frame, so it has no latency to measure.
+                if (!needsRedraw()) {
+                    inputPending = false;
+                }
+                // Idle time between redraws is not part of any frame.
+                lastFrameTime = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            // Events are polled once a packet slot is free, so each packet carries the newest input.
+            if (!framePackets.waitForSpace()) break;
+            if (options.adaptivePacing && presentWaitSupported) {
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(presentMonitor.getPaceDelayMilliseconds()));
+            }
+
+            frameDirty = false;
+            glfwPollEvents();
+            recordFrameTime();
+
+            FramePacket packet;
+            double buildStart = threadCpuSeconds();
+            buildFramePacket(packet);
+            simulationCpuSeconds += threadCpuSeconds() - buildStart;
+            if (!framePackets.push(packet)) break;
+        }
+
+        renderThreadGuard.join();
+        vkDeviceWaitIdle(device);
+        if (renderError) {
+            std::rethrow_exception(renderError);
+        }
+
+        flushCaptures();
+        collectGpuProfiles();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loopStart).count();
+        double cpuSeconds = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        reportUtilization(seconds, cpuSeconds);
+        reportDynamicResolution();
+        gpuProfiler.report();
+        memoryBudget.report();
+        queueSubmitter.report();
+    }
+
+    // Anything that changes the image marks the frame dirty; otherwise the last presented image stays on screen.
+    bool needsRedraw() {
+        return frameDirty || captureRequested || (ANIMATED_GROUP_COUNT > 0 && !animationPaused) || renderWorkPending;
+    }
+
+    // Runs on the main thread: advances the simulation and snapshots what the render thread needs for one frame.
+    void buildFramePacket(FramePacket& packet) {
+        packet.frameNumber = ++simulationFrameNumber;
+        packet.frameStart = std::chrono::steady_clock::now();
+        packet.hasInput = inputPending;
+        packet.inputTime = inputTime;
+        inputPending = false;
+        packet.calibration = options.calibrateDepthSort && gpuProfiler.statisticsSupported() && !gpuDrivenRendering && packet.frameNumber == DEPTH_SORT_CALIBRATION_FRAME;
+        packet.captureRequested = captureRequested;
+        captureRequested = false;
+
+        updateSceneTransforms(packet);
+        if (!gpuDrivenRendering) {
+            if (packet.calibration) {
+                sortDrawOrder(true, packet.drawOrder);
+                return;
+            }
+
+            // The view never moves, so the front-to-back order only changes when an object does.
+            if (!drawOrderSorted || !packet.changedInstances.empty()) {
+                sortDrawOrder(false, sortedDrawOrder);
+                drawOrderSorted = true;
+            }
+            packet.drawOrder = sortedDrawOrder;
+        }
+    }
+
+    void renderLoop() {
+        try {
+            FramePacket packet;
+            while (framePackets.pop(packet)) {
+                double drawStart = threadCpuSeconds();
+                drawFrame(packet);
+                renderCpuSeconds += threadCpuSeconds() - drawStart;
+
+                // Streaming textures and pending captures need further frames even when the scene is static.
+                bool pending = textureStreamingBusy() || captureRequestPending || captureRecording();
+                renderWorkPending = pending;
+                if (pending && options.onDemand) {
+                    glfwPostEmptyEvent();
+                }
+            }
+        } catch (...) {
+            renderError = std::current_exception();
+            framePackets.close();
+        }
+    }
+
+    // CPU time is the process time of every thread, so it can exceed 100% of a core while textures load.
+    void reportUtilization(double seconds, double cpuSeconds) {
+        if (seconds <= 0.0) return;
+
+        std::cout << "on-demand rendering " << (options.onDemand ? "on" : "off") << ": " << frameNumber << " frames in "
+                  << seconds << " s, cpu " << 100.0 * cpuSeconds / seconds << "% of a core";
+        if (gpuProfiler.timestampsSupported()) {
+            std::cout << ", gpu " << gpuBusyMilliseconds / (10.0 * seconds) << "%";
+        }
+        std::cout << std::endl;
+        // Only the frame work itself: building packets on the main thread and recording and submitting on the render thread.
+        if (frameNumber > 0) {
+            std::cout << "frame work cpu time: " << 1000.0 * (simulationCpuSeconds + renderCpuSeconds) / frameNumber << " ms per frame (main thread "
+                      << 1000.0 * simulationCpuSeconds / frameNumber << " ms, render thread " << 1000.0 * renderCpuSeconds / frameNumber << " ms)" << std::endl;
+        }
+    }
+
+    void recordFrameTime() {
+        auto now = std::chrono::steady_clock::now();
+        double milliseconds = std::chrono::duration<double, std::milli>(now - lastFrameTime).count();
+        lastFrameTime = now;
+
+        frameMilliseconds += milliseconds;
+        if (options.frameBudgetMilliseconds > 0.0 || options.frameLimit > 0) {
+            frameTimes.push_back(milliseconds);
+        }
+    }
+
+    // The first frames include swap chain and pipeline warm-up, so they are left out of measurements.
+    std::vector<double> measuredFrameTimes() const {
+        size_t warmupFrames = std::min<size_t>(frameTimes.size(), frameConfig.framesInFlight + 1);
+        return std::vector<double>(frameTimes.begin() + warmupFrames, frameTimes.end());
+    }
+
+    void checkFrameBudget() {
+        if (options.frameBudgetMilliseconds <= 0.0) return;
+
+        std::vector<double> measured = measuredFrameTimes();
+        if (measured.empty()) return;
+
+        std::sort(measured.begin(), measured.end());
+        double mean = std::accumulate(measured.begin(), measured.end(), 0.0) / measured.size();
+        double p95 = measured[std::min(measured.size() - 1, measured.size() * 95 / 100)];
+        std::cout << "frame time: mean " << mean << " ms, p95 " << p95 << " ms, budget " << options.frameBudgetMilliseconds << " ms" << std::endl;
+
+        if (p95 > options.frameBudgetMilliseconds) {
+            throw std::runtime_error("frame time budget exceeded!");
+        }
+    }
+
+    bool windowShouldClose() {
+        for (const auto& renderWindow : windows) {
+            if (glfwWindowShouldClose(renderWindow.window)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void reportStartupProfile() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        startupProfiler.printTree();
+        startupProfiler.writeJson("startup_profile.json", properties.deviceName);
+    }
+
+    void cleanup() {
+        textureLoader.stop();
+        captureWriter.stop();
+        reportCaptureStatistics();
+        if (presentWaitSupported) {
+            presentMonitor.stop();
+            presentMonitor.report();
+        }
+
+        for (size_t i = 0; i < frameConfig.framesInFlight; i++) {
+            vkDestroySemaphore(device, renderFinishedSemaphores[i], hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+            vkDestroyFence(device, inFlightFences[i], hostAllocator.callbacks(VK_OBJECT_TYPE_FENCE));
+
+            for (auto& renderWindow : windows) {
+                vkDestroySemaphore(device, renderWindow.imageAvailableSemaphores[i], hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+            }
+        }
+
+        vkDestroyCommandPool(device, commandPool, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+
+        vkDestroyBuffer(device, indexBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        memoryBudget.free(indexBufferMemory);
+
+        vkDestroyBuffer(device, vertexBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        memoryBudget.free(vertexBufferMemory);
+
+        vkDestroyBuffer(device, objectBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        memoryBudget.free(objectBufferMemory);
+
+        for (size_t i = 0; i < drawCommandBuffers.size(); i++) {
+            vkDestroyBuffer(device, drawCommandBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+            memoryBudget.free(drawCommandBuffersMemory[i]);
+            vkDestroyBuffer(device, drawCountBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+            memoryBudget.free(drawCountBuffersMemory[i]);
+            vkDestroyBuffer(device, instanceBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+            memoryBudget.free(instanceBuffersMemory[i]);
+        }
+
+        cleanupTextureStreaming();
+        cleanupCaptureResources();
+
+        for (auto& renderWindow : windows) {
+            for (auto framebuffer : renderWindow.swapChainFramebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+            }
+        }
+
+        renderGraph.destroy();
+
+        gpuProfiler.destroy();
+
+        graphicsPipeline.reset();
+        depthPrepassPipeline.reset();
+        pipelineLayout.reset();
+        cullPipeline.reset();
+        cullPipelineLayout.reset();
+        deletionQueue.flushAll();
+
+        vkDestroyRenderPass(device, renderPass, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+        vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+
+        for (auto& renderWindow : windows) {
+            for (auto imageView : renderWindow.swapChainImageViews) {
+                vkDestroyImageView(device, imageView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+            }
+
+            vkDestroySwapchainKHR(device, renderWindow.swapChain, hostAllocator.callbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
+        }
+
+        vkDestroyDevice(device, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE));
+
+        if (enableValidationLayers) {
+            destroyDebugUtilsMessenger(instance, debugMessenger, hostAllocator.callbacks(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT));
+        }
+
+        for (auto& renderWindow : windows) {
+            vkDestroySurfaceKHR(instance, renderWindow.surface, hostAllocator.callbacks(VK_OBJECT_TYPE_SURFACE_KHR));
+        }
+        vkDestroyInstance(instance, hostAllocator.callbacks(VK_OBJECT_TYPE_INSTANCE));
+
+        for (auto& renderWindow : windows) {
+            glfwDestroyWindow(renderWindow.window);
+        }
+
+        glfwTerminate();
+
+        hostAllocator.printStatistics();
+    }
+
+    void createInstance() {
+        ProfileScope scope(startupProfiler, "createInstance");
+
+        if (enableValidationLayers && !checkValidationLayerSupport()) {
+            throw std::runtime_error("validation layers requested, but not available!");
+        }
+
+        VkApplicationInfo appInfo{};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "Hello Triangle";
+        appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        appInfo.pEngineName = "No Engine";
+        appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+        appInfo.apiVersion = VK_API_VERSION_1_1;
+
+        VkInstanceCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        createInfo.pApplicationInfo = &appInfo;
+
+        auto extensions = getRequiredExtensions();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
+
+        VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
+        if (enableValidationLayers) {
+            createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+            createInfo.ppEnabledLayerNames = validationLayers.data();
+
+            populateDebugMessengerCreateInfo(debugCreateInfo);
+            createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debugCreateInfo;
+        } else {
+            createInfo.enabledLayerCount = 0;
+
+            createInfo.pNext = nullptr;
+        }
+
+        ProfileScope loaderScope(startupProfiler, "vkCreateInstance");
+        if (vkCreateInstance(&createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_INSTANCE), &instance) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create instance!");
+        }
+    }
+
+    void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
+        createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+        createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        createInfo.pfnUserCallback = debugCallback;
+    }
+
+    void setupDebugMessenger() {
+        ProfileScope scope(startupProfiler, "setupDebugMessenger");
+
+        if (!enableValidationLayers) return;
+
+        VkDebugUtilsMessengerCreateInfoEXT createInfo;
+        populateDebugMessengerCreateInfo(createInfo);
+
+        // Both entry points are looked up once here; cleanup() reuses the destroy function.
+        auto createDebugUtilsMessenger = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+        destroyDebugUtilsMessenger = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+        if (createDebugUtilsMessenger == nullptr || destroyDebugUtilsMessenger == nullptr ||
+            createDebugUtilsMessenger(instance, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT), &debugMessenger) != VK_SUCCESS) {
+            throw std::runtime_error("failed to set up debug messenger!");
+        }
+    }
+
+    void createSurfaces() {
+        ProfileScope scope(startupProfiler, "createSurfaces");
+
+        for (auto& renderWindow : windows) {
+            if (glfwCreateWindowSurface(instance, renderWindow.window, hostAllocator.callbacks(VK_OBJECT_TYPE_SURFACE_KHR), &renderWindow.surface) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create window surface!");
+            }
+        }
+    }
+
+    void pickPhysicalDevice() {
+        ProfileScope scope(startupProfiler, "pickPhysicalDevice");
+
+        std::vector<VkPhysicalDevice> devices;
+        {
+            ProfileScope enumerateScope(startupProfiler, "vkEnumeratePhysicalDevices");
+
+            uint32_t deviceCount = 0;
+            vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+
+            if (deviceCount == 0) {
+                throw std::runtime_error("failed to find GPUs with Vulkan support!");
+            }
+
+            devices.resize(deviceCount);
+            vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+        }
+
+        ProfileScope suitabilityScope(startupProfiler, "isDeviceSuitable");
+        for (const auto& device : devices) {
+            if (isDeviceSuitable(device)) {
+                physicalDevice = device;
+                break;
+            }
+        }
+
+        if (physicalDevice == VK_NULL_HANDLE) {
+            throw std::runtime_error("failed to find a suitable GPU!");
+        }
+
+        msaaSamples = getMaxUsableSampleCount(MSAA_SAMPLES);
+        depthFormat = findDepthFormat();
+    }
+
+    VkSampleCountFlagBits getMaxUsableSampleCount(VkSampleCountFlagBits requestedSamples) {
+        VkPhysicalDeviceProperties physicalDeviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+        VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+
+        const VkSampleCountFlagBits candidates[] = {
+            VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT, VK_SAMPLE_COUNT_16_BIT,
+            VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT
+        };
+        for (VkSampleCountFlagBits candidate : candidates) {
+            if (candidate <= requestedSamples && (counts & candidate)) {
+                return candidate;
+            }
+        }
+
+        return VK_SAMPLE_COUNT_1_BIT;
+    }
+
+    void createLogicalDevice() {
+        ProfileScope scope(startupProfiler, "createLogicalDevice");
+
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value()};
+
+        float queuePriority = 1.0f;
+        for (uint32_t queueFamily : uniqueQueueFamilies) {
+            VkDeviceQueueCreateInfo queueCreateInfo{};
+            queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueCreateInfo.queueFamilyIndex = queueFamily;
+            queueCreateInfo.queueCount = 1;
+            queueCreateInfo.pQueuePriorities = &queuePriority;
+            queueCreateInfos.push_back(queueCreateInfo);
+        }
+
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+        VkPhysicalDeviceFeatures deviceFeatures{};
+        deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+        pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
+        gpuDrivenRendering = frameConfig.gpuDrivenRendering && supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+        frameConfig.gpuDrivenRendering = gpuDrivenRendering;
+        deviceFeatures.multiDrawIndirect = gpuDrivenRendering ? VK_TRUE : VK_FALSE;
+        deviceFeatures.drawIndirectFirstInstance = gpuDrivenRendering ? VK_TRUE : VK_FALSE;
+
+        std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        drawIndirectCountSupported = gpuDrivenRendering && isDeviceExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        if (drawIndirectCountSupported) {
+            enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        memoryBudgetSupported = properties.apiVersion >= VK_API_VERSION_1_1 && isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (memoryBudgetSupported) {
+            enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.pNext = &presentIdFeatures;
+        presentWaitSupported = isPresentWaitSupported(presentWaitFeatures);
+        if (presentWaitSupported) {
+            enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
+
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+        synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        synchronization2Supported = isSynchronization2Supported(synchronization2Features);
+        if (synchronization2Supported) {
+            enabledExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        }
+
+        void* featureChain = nullptr;
+        if (presentWaitSupported) {
+            presentIdFeatures.pNext = featureChain;
+            featureChain = &presentWaitFeatures;
+        }
+        if (synchronization2Supported) {
+            synchronization2Features.pNext = featureChain;
+            featureChain = &synchronization2Features;
+        }
+
+        VkDeviceCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = featureChain;
+
+        createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+        createInfo.pQueueCreateInfos = queueCreateInfos.data();
+
+        createInfo.pEnabledFeatures = &deviceFeatures;
+
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
+
+        if (enableValidationLayers) {
+            createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+            createInfo.ppEnabledLayerNames = validationLayers.data();
+        } else {
+            createInfo.enabledLayerCount = 0;
+        }
+
+        ProfileScope deviceScope(startupProfiler, "vkCreateDevice");
+        if (vkCreateDevice(physicalDevice, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE), &device) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create logical device!");
+        }
+        dispatch.load(device);
+
+        vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
+        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+
+        if (drawIndirectCountSupported) {
+            dispatch.cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+        }
+
+        if (presentWaitSupported) {
+            dispatch.waitForPresent = (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+        }
+
+        if (synchronization2Supported) {
+            dispatch.queueSubmit2 = (PFN_vkQueueSubmit2KHR) vkGetDeviceProcAddr(device, "vkQueueSubmit2KHR");
+            dispatch.cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR) vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR");
+        }
+        queueSubmitter.init(dispatch);
+
+        memoryBudget.init(physicalDevice, device, hostAllocator, memoryBudgetSupported);
+    }
+
+    bool isSynchronization2Supported(VkPhysicalDeviceSynchronization2FeaturesKHR& features) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_1 || !isDeviceExtensionSupported(physicalDevice, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+            return false;
+        }
+
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &features;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        return features.synchronization2 == VK_TRUE;
+    }
+
+    // Fills features with the device's present id and present wait support. Querying features through pNext needs
+    // Vulkan 1.1 on the device as well.
+    bool isPresentWaitSupported(VkPhysicalDevicePresentWaitFeaturesKHR& features) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_1 || !isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+            !isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+            return false;
+        }
+
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &features;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        auto presentIdFeatures = static_cast<VkPhysicalDevicePresentIdFeaturesKHR*>(features.pNext);
+        return features.presentWait == VK_TRUE && presentIdFeatures->presentId == VK_TRUE;
+    }
+
+    void createSwapChains() {
+        ProfileScope scope(startupProfiler, "createSwapChains");
+
+        for (auto& renderWindow : windows) {
+            createSwapChain(renderWindow);
+        }
+
+        for (const auto& renderWindow : windows) {
+            if (renderWindow.swapChainImageFormat != windows[0].swapChainImageFormat) {
+                throw std::runtime_error("swap chains with different image formats are not supported!");
+            }
+        }
+    }
+
+    void createSwapChain(RenderWindow& renderWindow) {
+        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, renderWindow.surface);
+
+        VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
+        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        VkExtent2D extent = chooseSwapExtent(renderWindow.window, swapChainSupport.capabilities);
+
+        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + frameConfig.extraSwapChainImages;
+        if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
+            imageCount = swapChainSupport.capabilities.maxImageCount;
+        }
+        frameConfig.presentMode = presentMode;
+        frameConfig.extraSwapChainImages = imageCount - swapChainSupport.capabilities.minImageCount;
+
+        VkSwapchainCreateInfoKHR createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+        createInfo.surface = renderWindow.surface;
+
+        createInfo.minImageCount = imageCount;
+        createInfo.imageFormat = surfaceFormat.format;
+        createInfo.imageColorSpace = surfaceFormat.colorSpace;
+        createInfo.imageExtent = extent;
+        createInfo.imageArrayLayers = 1;
+        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        renderWindow.swapChainTransferSrc = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+        if (renderWindow.swapChainTransferSrc) {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+        renderWindow.swapChainTransferDst = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+        if (renderWindow.swapChainTransferDst) {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
+
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+
+        if (indices.graphicsFamily != indices.presentFamily) {
+            createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+            createInfo.queueFamilyIndexCount = 2;
+            createInfo.pQueueFamilyIndices = queueFamilyIndices;
+        } else {
+            createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
+
+        createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+        createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        createInfo.presentMode = presentMode;
+        createInfo.clipped = VK_TRUE;
+
+        createInfo.oldSwapchain = VK_NULL_HANDLE;
+
+        if (vkCreateSwapchainKHR(device, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR), &renderWindow.swapChain) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create swap chain!");
+        }
+
+        vkGetSwapchainImagesKHR(device, renderWindow.swapChain, &imageCount, nullptr);
+        renderWindow.swapChainImages.resize(imageCount);
+        vkGetSwapchainImagesKHR(device, renderWindow.swapChain, &imageCount, renderWindow.swapChainImages.data());
+
+        renderWindow.swapChainImageFormat = surfaceFormat.format;
+        renderWindow.swapChainExtent = extent;
+    }
+
+    void createImageViews() {
+        ProfileScope scope(startupProfiler, "createImageViews");
+
+        for (auto& renderWindow : windows) {
+            renderWindow.swapChainImageViews.resize(renderWindow.swapChainImages.size());
+
+            for (size_t i = 0; i < renderWindow.swapChainImages.size(); i++) {
+                renderWindow.swapChainImageViews[i] = createImageView(renderWindow.swapChainImages[i], renderWindow.swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+            }
+        }
+    }
+
+    // The upscale is a blit into the swap chain image, and the controller needs GPU timestamps.
+    void createDynamicResolution() {
+        ProfileScope scope(startupProfiler, "createDynamicResolution");
+
+        if (options.targetGpuMilliseconds <= 0.0) return;
+        if (options.deterministic) {
+            std::cout << "dynamic resolution is disabled in deterministic runs" << std::endl;
+            return;
+        }
+
+        bool transferDst = true;
+        for (const auto& renderWindow : windows) {
+            transferDst = transferDst && renderWindow.swapChainTransferDst;
+        }
+
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, windows[0].swapChainImageFormat, &properties);
+        VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+        if (!transferDst || (properties.optimalTilingFeatures & blitFeatures) != blitFeatures || graphicsTimestampValidBits() == 0) {
+            std::cout << "dynamic resolution is not supported by this device" << std::endl;
+            return;
+        }
+
+        upscaleFilter = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+        dynamicResolution = true;
+    }
+
+    VkExtent2D scaledExtent(VkExtent2D extent) const {
+        return {
+            std::max(1u, static_cast<uint32_t>(extent.width * resolutionScale + 0.5)),
+            std::max(1u, static_cast<uint32_t>(extent.height * resolutionScale + 0.5))
+        };
+    }
+
+    // GPU time grows roughly with pixel count, so the scale that would meet the target is the current scale times
+    // the square root of target over measured time.
+    void updateResolutionScale(double gpuMilliseconds) {
+        if (!dynamicResolution) return;
+
+        smoothedGpuMilliseconds = smoothedGpuMilliseconds == 0.0 ? gpuMilliseconds : smoothedGpuMilliseconds + RESOLUTION_SMOOTHING * (gpuMilliseconds - smoothedGpuMilliseconds);
+        resolutionScaleTotal += resolutionScale;
+        resolutionScaleSamples++;
+
+        double ratio = options.targetGpuMilliseconds / std::max(smoothedGpuMilliseconds, 0.001);
+        if (std::abs(ratio - 1.0) < RESOLUTION_DEAD_BAND) return;
+
+        double desired = std::clamp(resolutionScale * std::sqrt(ratio), resolutionScale - RESOLUTION_MAX_STEP, resolutionScale + RESOLUTION_MAX_STEP);
+        resolutionScale = std::clamp(desired, MIN_RESOLUTION_SCALE, 1.0);
+    }
+
+    void reportDynamicResolution() {
+        if (!dynamicResolution || resolutionScaleSamples == 0) return;
+
+        std::cout << "dynamic resolution: mean scale " << resolutionScaleTotal / resolutionScaleSamples << ", final scale " << resolutionScale
+                  << ", smoothed gpu time " << smoothedGpuMilliseconds << " ms, target " << options.targetGpuMilliseconds << " ms" << std::endl;
+    }
+
+    void createRenderPass() {
+        ProfileScope scope(startupProfiler, "createRenderPass");
+
+        bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = windows[0].swapChainImageFormat;
+        colorAttachment.samples = msaaSamples;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentDescription colorAttachmentResolve{};
+        colorAttachmentResolve.format = windows[0].swapChainImageFormat;
+        colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentRef{};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = msaaSamples;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentResolveRef{};
+        colorAttachmentResolveRef.attachment = 2;
+        colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+        subpass.pResolveAttachments = multisampled ? &colorAttachmentResolveRef : nullptr;
+
+        std::vector<VkAttachmentDescription> attachments = {colorAttachment, depthAttachment};
+        if (multisampled) {
+            attachments.push_back(colorAttachmentResolve);
+        }
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        if (vkCreateRenderPass(device, &renderPassInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS), &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render pass!");
+        }
+    }
+
+    void createGraphicsPipeline() {
+        ProfileScope scope(startupProfiler, "createGraphicsPipeline");
+
+        VkShaderModule vertShaderModule;
+        VkShaderModule fragShaderModule;
+        {
+            ProfileScope shaderScope(startupProfiler, "loadShaders");
+            auto vertShaderCode = readFile("shaders/vert.spv");
+            auto fragShaderCode = readFile("shaders/frag.spv");
+
+            vertShaderModule = createShaderModule(vertShaderCode);
+            fragShaderModule = createShaderModule(fragShaderCode);
+        }
+
+        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertShaderStageInfo.module = vertShaderModule;
+        vertShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragShaderStageInfo.module = fragShaderModule;
+        fragShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        auto bindingDescription = Vertex::getBindingDescription();
+        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        VkPipelineViewportStateCreateInfo viewportState{};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE;
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterizer.depthBiasEnable = VK_FALSE;
+
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = msaaSamples;
+
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = DEPTH_PREPASS ? VK_FALSE : VK_TRUE;
+        depthStencil.depthCompareOp = DEPTH_PREPASS ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+        depthStencil.depthBoundsTestEnable = VK_FALSE;
+        depthStencil.stencilTestEnable = VK_FALSE;
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+
+        VkPipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.logicOpEnable = VK_FALSE;
+        colorBlending.logicOp = VK_LOGIC_OP_COPY;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+        colorBlending.blendConstants[0] = 0.0f;
+        colorBlending.blendConstants[1] = 0.0f;
+        colorBlending.blendConstants[2] = 0.0f;
+        colorBlending.blendConstants[3] = 0.0f;
+
+        std::vector<VkDynamicState> dynamicStates = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR
+        };
+        VkPipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+        dynamicState.pDynamicStates = dynamicStates.data();
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+
+        VkPipelineLayout newPipelineLayout;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &newPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        pipelineLayout = DeferredHandle<VkPipelineLayout>(deletionQueue, device, newPipelineLayout, vkDestroyPipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = pipelineLayout.get();
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.subpass = 0;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        {
+            ProfileScope pipelineScope(startupProfiler, "vkCreateGraphicsPipelines");
+            VkPipeline newGraphicsPipeline;
+            if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &newGraphicsPipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create graphics pipeline!");
+            }
+            graphicsPipeline = DeferredHandle<VkPipeline>(deletionQueue, device, newGraphicsPipeline, vkDestroyPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+
+            if (DEPTH_PREPASS) {
+                depthStencil.depthWriteEnable = VK_TRUE;
+                depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+                colorBlendAttachment.colorWriteMask = 0;
+
+                pipelineInfo.stageCount = 1;
+                pipelineInfo.pStages = &vertShaderStageInfo;
+
+                VkPipeline newDepthPrepassPipeline;
+                if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &newDepthPrepassPipeline) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create depth pre-pass pipeline!");
+                }
+                depthPrepassPipeline = DeferredHandle<VkPipeline>(deletionQueue, device, newDepthPrepassPipeline, vkDestroyPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+            }
+        }
+
+        vkDestroyShaderModule(device, fragShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+        vkDestroyShaderModule(device, vertShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+
+    void createFramebuffers() {
+        ProfileScope scope(startupProfiler, "createFramebuffers");
+
+        for (auto& renderWindow : windows) {
+            createWindowFramebuffers(renderWindow);
+        }
+    }
+
+    void createWindowFramebuffers(RenderWindow& renderWindow) {
+        renderWindow.swapChainFramebuffers.resize(renderWindow.swapChainImageViews.size());
+
+        VkImageView depthImageView = renderGraph.getImageView(renderWindow.depthResource);
+
+        for (size_t i = 0; i < renderWindow.swapChainImageViews.size(); i++) {
+            VkImageView target = dynamicResolution ? renderGraph.getImageView(renderWindow.sceneColorResource) : renderWindow.swapChainImageViews[i];
+            std::vector<VkImageView> attachments;
+            if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+                attachments = {renderGraph.getImageView(renderWindow.colorResource), depthImageView, target};
+            } else {
+                attachments = {target, depthImageView};
+            }
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = renderWindow.swapChainExtent.width;
+            framebufferInfo.height = renderWindow.swapChainExtent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(device, &framebufferInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &renderWindow.swapChainFramebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer!");
+            }
+        }
+    }
+
+    void createRenderGraph() {
+        ProfileScope scope(startupProfiler, "createRenderGraph");
+
+        renderGraph.init(device, hostAllocator, memoryBudget, deletionQueue, [this](const VkMemoryRequirements& memRequirements, VkImageUsageFlags usage) {
+            return allocateImageMemory(memRequirements, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }, dispatch);
+
+        buildRenderGraph();
+        renderGraph.compile();
+    }
+
+    void buildRenderGraph() {
+        renderGraph.reset();
+
+        for (size_t i = 0; i < windows.size(); i++) {
+            RenderWindow& renderWindow = windows[i];
+
+            RenderGraphImageDesc swapChainDesc{renderWindow.swapChainImageFormat, renderWindow.swapChainExtent, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT};
+            uint32_t swapChainImage = renderGraph.importImage("swapChainImage", swapChainDesc, renderWindow.swapChainImages[renderWindow.imageIndex], renderWindow.swapChainImageViews[renderWindow.imageIndex], RenderGraphAccess::Present);
+            renderWindow.swapChainResource = swapChainImage;
+
+            RenderGraphImageDesc depthDesc{depthFormat, renderWindow.swapChainExtent, msaaSamples, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT};
+            renderWindow.depthResource = renderGraph.createImage("depth", depthDesc);
+
+            // With dynamic resolution the scene goes to a full-size offscreen image, of which only the scaled
+            // sub-rectangle is rendered and then upscaled, so scale changes never reallocate or recompile anything.
+            uint32_t sceneTarget = swapChainImage;
+            if (dynamicResolution) {
+                RenderGraphImageDesc sceneColorDesc{renderWindow.swapChainImageFormat, renderWindow.swapChainExtent, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT};
+                renderWindow.sceneColorResource = renderGraph.createImage("sceneColor", sceneColorDesc);
+                sceneTarget = renderWindow.sceneColorResource;
+            }
+
+            uint32_t pass = renderGraph.addPass("scene", [this, i](VkCommandBuffer commandBuffer) {
+                recordRenderPass(commandBuffer, windows[i]);
+            });
+            renderGraph.write(pass, renderWindow.depthResource, RenderGraphAccess::DepthAttachment);
+            renderGraph.write(pass, sceneTarget, RenderGraphAccess::ColorAttachment);
+
+            if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+                RenderGraphImageDesc colorDesc{renderWindow.swapChainImageFormat, renderWindow.swapChainExtent, msaaSamples, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT};
+                renderWindow.colorResource = renderGraph.createImage("color", colorDesc);
+                renderGraph.write(pass, renderWindow.colorResource, RenderGraphAccess::ColorAttachment);
+            }
+
+            if (dynamicResolution) {
+                uint32_t upscalePass = renderGraph.addPass("upscale", [this, i](VkCommandBuffer commandBuffer) {
+                    recordUpscale(commandBuffer, windows[i]);
+                });
+                renderGraph.read(upscalePass, renderWindow.sceneColorResource, RenderGraphAccess::TransferSrc);
+                renderGraph.write(upscalePass, swapChainImage, RenderGraphAccess::TransferDst);
+            }
+
+            // In continuous mode the pass stays in the graph even on frames without a free slot, so the graph
+            // structure does not change from frame to frame.
+            if (i == 0 && captureSupported && (CAPTURE_INTERVAL > 0 || activeCaptureSlot != UINT32_MAX)) {
+                uint32_t capturePass = renderGraph.addPass("capture", [this](VkCommandBuffer commandBuffer) {
+                    recordCapture(commandBuffer, windows[0]);
+                });
+                renderGraph.read(capturePass, swapChainImage, RenderGraphAccess::TransferSrc);
+            }
+        }
+    }
+
+    void retireFramebuffers(RenderWindow& renderWindow) {
+        VkDevice device = this->device;
+        HostAllocator* hostAllocator = &this->hostAllocator;
+        std::vector<VkFramebuffer> framebuffers = std::move(renderWindow.swapChainFramebuffers);
+        deletionQueue.push([device, hostAllocator, framebuffers]() {
+            for (auto framebuffer : framebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, hostAllocator->callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+            }
+        });
+    }
+
+    VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+        for (VkFormat format : candidates) {
+            VkFormatProperties props;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+            if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
+                return format;
+            } else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+                return format;
+            }
+        }
+
+        throw std::runtime_error("failed to find supported format!");
+    }
+
+    VkFormat findDepthFormat() {
+        return findSupportedFormat(
+            {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+        );
+    }
+
+    void createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = width;
+        imageInfo.extent.height = height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = tiling;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.samples = numSamples;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(device, &imageInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE), &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+        imageMemory = allocateImageMemory(memRequirements, usage, properties);
+
+        vkBindImageMemory(device, image, imageMemory, 0);
+    }
+
+    VkDeviceMemory allocateImageMemory(const VkMemoryRequirements& memRequirements, VkImageUsageFlags usage, VkMemoryPropertyFlags properties) {
+        VkMemoryPropertyFlags preferred = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+
+        VkDeviceMemory imageMemory;
+        if (memoryBudget.allocate(memRequirements.size, memRequirements.memoryTypeBits, properties, preferred, imageMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate image memory!");
+        }
+
+        return imageMemory;
+    }
+
+    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = aspectFlags;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        VkImageView imageView;
+        if (vkCreateImageView(device, &viewInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &imageView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image view!");
+        }
+
+        return imageView;
+    }
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER), &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+        if (memoryBudget.allocate(memRequirements.size, memRequirements.memoryTypeBits, properties, 0, bufferMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate buffer memory!");
+        }
+
+        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    }
+
+    VkCommandBuffer beginSingleTimeCommands() {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        return commandBuffer;
+    }
+
+    void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(graphicsQueue);
+
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    }
+
+    bool tryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& memoryTypeIndex) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                memoryTypeIndex = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void createCommandPool() {
+        ProfileScope scope(startupProfiler, "createCommandPool");
+
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        if (vkCreateCommandPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+    }
+
+    void createCommandBuffers() {
+        ProfileScope scope(startupProfiler, "createCommandBuffers");
+
+        commandBuffers.resize(frameConfig.framesInFlight);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = (uint32_t) commandBuffers.size();
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+    }
+
+    void recordCommandBuffer(VkCommandBuffer commandBuffer) {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+        if (dispatch.beginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+
+        // The frame scope is always the first one, so its sample comes first when the slot is collected.
+        gpuProfiler.beginFrame(commandBuffer, currentFrame);
+        uint32_t frameScope = gpuProfiler.beginScope(commandBuffer, "frame", true);
+
+        if (gpuDrivenRendering) {
+            uint32_t cullScope = gpuProfiler.beginScope(commandBuffer, "cull");
+            recordCulling(commandBuffer);
+            gpuProfiler.endScope(commandBuffer, cullScope);
+        }
+
+        renderGraph.execute(commandBuffer, gpuProfiler);
+        gpuProfiler.endScope(commandBuffer, frameScope);
+
+        if (dispatch.endCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+
+    void recordRenderPass(VkCommandBuffer commandBuffer, const RenderWindow& renderWindow) {
+        VkExtent2D renderExtent = dynamicResolution ? scaledExtent(renderWindow.swapChainExtent) : renderWindow.swapChainExtent;
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = renderWindow.swapChainFramebuffers[renderWindow.imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = renderExtent;
+
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clearValues[1].depthStencil = {1.0f, 0};
+
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+
+        dispatch.cmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+            VkViewport viewport{};
+            viewport.x = 0.0f;
+            viewport.y = 0.0f;
+            viewport.width = (float) renderExtent.width;
+            viewport.height = (float) renderExtent.height;
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            dispatch.cmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+            VkRect2D scissor{};
+            scissor.offset = {0, 0};
+            scissor.extent = renderExtent;
+            dispatch.cmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+            dispatch.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout.get(), 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+
+            if (DEPTH_PREPASS) {
+                dispatch.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline.get());
+                recordSceneDraws(commandBuffer);
+            }
+
+            dispatch.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.get());
+            recordSceneDraws(commandBuffer);
+
+        dispatch.cmdEndRenderPass(commandBuffer);
+    }
+
+    void recordUpscale(VkCommandBuffer commandBuffer, const RenderWindow& renderWindow) {
+        VkExtent2D source = scaledExtent(renderWindow.swapChainExtent);
+
+        // Linear filtering clamps to the edge of the whole image, not of the scaled region, so at the region's far
+        // edges it would blend in stale texels from earlier, larger frames. Dropping the last row and column keeps
+        // every filter tap inside the region.
+        if (upscaleFilter == VK_FILTER_LINEAR) {
+            if (source.width < renderWindow.swapChainExtent.width) source.width = std::max(source.width - 1, 1u);
+            if (source.height < renderWindow.swapChainExtent.height) source.height = std::max(source.height - 1, 1u);
+        }
+
+        VkImageBlit blit{};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        blit.srcOffsets[1] = {static_cast<int32_t>(source.width), static_cast<int32_t>(source.height), 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        blit.dstOffsets[1] = {static_cast<int32_t>(renderWindow.swapChainExtent.width), static_cast<int32_t>(renderWindow.swapChainExtent.height), 1};
+
+        dispatch.cmdBlitImage(commandBuffer, renderGraph.getImage(renderWindow.sceneColorResource), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            renderWindow.swapChainImages[renderWindow.imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, upscaleFilter);
+    }
+
+    void recordSceneDraws(VkCommandBuffer commandBuffer) {
+        VkBuffer vertexBuffers[] = {vertexBuffer};
+        VkDeviceSize offsets[] = {0};
+        dispatch.cmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        dispatch.cmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+
+        if (gpuDrivenRendering) {
+            uint32_t maxDrawCount = static_cast<uint32_t>(sceneObjects.size());
+            if (drawIndirectCountSupported) {
+                dispatch.cmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffers[currentFrame], 0, drawCountBuffers[currentFrame], 0, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+            } else {
+                dispatch.cmdDrawIndexedIndirect(commandBuffer, drawCommandBuffers[currentFrame], 0, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+            }
+            return;
+        }
+
+        for (uint32_t index : drawOrder) {
+            dispatch.cmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, index);
+        }
+    }
+
+    // Records the same draws through the loader's exported vkCmdDrawIndexed and through the dispatch table and
+    // prints what recording costs per call. Nothing is submitted.
+    void benchmarkDispatch() {
+        std::cout << std::left << std::setw(10) << "draws" << std::setw(14) << "loader ns" << std::setw(14) << "dispatch ns" << "saved" << std::endl;
+        for (uint32_t drawCount : DISPATCH_BENCHMARK_DRAWS) {
+            // The paths take turns going first, so warm-up and cache effects do not favor either one.
+            double loader = std::numeric_limits<double>::max();
+            double direct = std::numeric_limits<double>::max();
+            for (uint32_t repeat = 0; repeat < DISPATCH_BENCHMARK_REPEATS; repeat++) {
+                for (uint32_t pass = 0; pass < 2; pass++) {
+                    bool throughDispatch = (pass == 0) == (repeat % 2 == 1);
+                    double seconds = timeDrawRecording(drawCount, throughDispatch);
+                    double& best = throughDispatch ? direct : loader;
+                    best = std::min(best, seconds);
+                }
+            }
+            std::cout << std::left << std::setw(10) << drawCount << std::setw(14) << std::fixed << std::setprecision(2) << loader * 1e9 / drawCount
+                      << std::setw(14) << direct * 1e9 / drawCount << std::setprecision(1) << 100.0 * (loader - direct) / loader << "%" << std::endl;
+        }
+        vkDeviceWaitIdle(device);
+    }
+
+    double timeDrawRecording(uint32_t drawCount, bool throughDispatch) {
+        const RenderWindow& renderWindow = windows[0];
+        VkCommandBuffer commandBuffer = commandBuffers[0];
+        uint32_t indexCount = static_cast<uint32_t>(indices.size());
+        uint32_t instanceCount = static_cast<uint32_t>(sceneObjects.size());
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        std::array<VkClearValue, 2> clearValues{};
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = renderWindow.swapChainFramebuffers[0];
+        renderPassInfo.renderArea.extent = renderWindow.swapChainExtent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+
+        VkBuffer vertexBuffers[] = {vertexBuffer};
+        VkDeviceSize offsets[] = {0};
+        dispatch.resetCommandBuffer(commandBuffer, 0);
+        if (dispatch.beginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        dispatch.cmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        dispatch.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.get());
+        dispatch.cmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        dispatch.cmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+
+        auto start = std::chrono::steady_clock::now();
+        if (throughDispatch) {
+            for (uint32_t i = 0; i < drawCount; i++) {
+                dispatch.cmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, i % instanceCount);
+            }
+        } else {
+            for (uint32_t i = 0; i < drawCount; i++) {
+                vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, i % instanceCount);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        dispatch.cmdEndRenderPass(commandBuffer);
+        if (dispatch.endCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+        return seconds;
+    }
+
+    void createSyncObjects() {
+        ProfileScope scope(startupProfiler, "createSyncObjects");
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        renderFinishedSemaphores.resize(frameConfig.framesInFlight);
+        inFlightFences.resize(frameConfig.framesInFlight);
+        inFlightFrameNumbers.resize(frameConfig.framesInFlight, 0);
+
+        for (size_t i = 0; i < frameConfig.framesInFlight; i++) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(device, &fenceInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_FENCE), &inFlightFences[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+
+        for (auto& renderWindow : windows) {
+            renderWindow.imageAvailableSemaphores.resize(frameConfig.framesInFlight);
+
+            for (size_t i = 0; i < frameConfig.framesInFlight; i++) {
+                if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &renderWindow.imageAvailableSemaphores[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create synchronization objects for a frame!");
+                }
+            }
+        }
+    }
+
+    void loadModel() {
+        ProfileScope scope(startupProfiler, "loadModel");
+
+        MeshData mesh;
+        if (!loadObj(MODEL_PATH, mesh)) {
+            std::cout << MODEL_PATH << " not found, using a generated sphere" << std::endl;
+            mesh = generateSphere(48, 96);
+        }
+
+        float acmrBefore = computeAcmr(mesh.indices, 16);
+        mesh.indices = optimizeVertexCache(mesh.indices, mesh.vertexCount());
+        optimizeVertexFetch(mesh);
+        float acmrAfter = computeAcmr(mesh.indices, 16);
+
+        vertices = quantizeVertices(mesh);
+        indices = std::move(mesh.indices);
+
+        size_t unpackedVertexSize = sizeof(float) * 8;
+        size_t indexSize = vertices.size() <= std::numeric_limits<uint16_t>::max() ? sizeof(uint16_t) : sizeof(uint32_t);
+        std::cout << "mesh: " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, vertex "
+                  << unpackedVertexSize << " -> " << sizeof(Vertex) << " bytes (" << (unpackedVertexSize - sizeof(Vertex)) * vertices.size() << " bytes saved), index "
+                  << sizeof(uint32_t) << " -> " << indexSize << " bytes, ACMR " << acmrBefore << " -> " << acmrAfter << std::endl;
+    }
+
+    void createVertexBuffer() {
+        ProfileScope scope(startupProfiler, "createVertexBuffer");
+
+        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+        createDeviceLocalBuffer(vertices.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
+    }
+
+    void createIndexBuffer() {
+        ProfileScope scope(startupProfiler, "createIndexBuffer");
+
+        if (vertices.size() <= std::numeric_limits<uint16_t>::max()) {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            indexType = VK_INDEX_TYPE_UINT16;
+            createDeviceLocalBuffer(shortIndices.data(), sizeof(shortIndices[0]) * shortIndices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferMemory);
+        } else {
+            indexType = VK_INDEX_TYPE_UINT32;
+            createDeviceLocalBuffer(indices.data(), sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferMemory);
+        }
+    }
+
+    void createDeviceLocalBuffer(const void* contents, VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, contents, (size_t) bufferSize);
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+
+        copyBuffer(stagingBuffer, buffer, bufferSize);
+
+        vkDestroyBuffer(device, stagingBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        memoryBudget.free(stagingBufferMemory);
+    }
+
+    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = size;
+        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+        endSingleTimeCommands(commandBuffer);
+    }
+
+    void createGpuProfiler() {
+        ProfileScope scope(startupProfiler, "createGpuProfiler");
+
+        inFlightCalibration.resize(frameConfig.framesInFlight, false);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        uint32_t timestampValidBits = graphicsTimestampValidBits();
+        if (timestampValidBits == 0) {
+            std::cout << "the graphics queue does not support timestamps; gpu timings are not measured" << std::endl;
+        }
+
+        gpuProfiler.init(device, dispatch, hostAllocator, frameConfig.framesInFlight, timestampValidBits, properties.limits.timestampPeriod, pipelineStatisticsSupported);
+    }
+
+    uint32_t graphicsTimestampValidBits() {
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        return queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+    }
+
+    void createInputCallbacks() {
+        ProfileScope scope(startupProfiler, "createInputCallbacks");
+
+        for (auto& renderWindow : windows) {
+            glfwSetWindowUserPointer(renderWindow.window, this);
+            glfwSetKeyCallback(renderWindow.window, keyCallback);
+            glfwSetCursorPosCallback(renderWindow.window, cursorPositionCallback);
+            glfwSetMouseButtonCallback(renderWindow.window, mouseButtonCallback);
+            glfwSetScrollCallback(renderWindow.window, scrollCallback);
+            glfwSetWindowRefreshCallback(renderWindow.window, windowRefreshCallback);
+        }
+    }
+
+    static void markDirty(GLFWwindow* window) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        app->frameDirty = true;
+    }
+
+    // The oldest input not yet picked up by a frame packet is the one whose latency that frame measures. Input only
+    // marks the frame dirty where it changes the image; the view is fixed, so the mouse never does.
+    static void recordInput(GLFWwindow* window) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        if (!app->inputPending) {
+            app->inputPending = true;
+            app->inputTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    static void cursorPositionCallback(GLFWwindow* window, double, double) {
+        recordInput(window);
+    }
+
+    static void mouseButtonCallback(GLFWwindow* window, int, int, int) {
+        recordInput(window);
+    }
+
+    static void scrollCallback(GLFWwindow* window, double, double) {
+        recordInput(window);
+    }
+
+    void createPresentMonitor() {
+        ProfileScope scope(startupProfiler, "createPresentMonitor");
+
+        if (!presentWaitSupported) {
+            std::cout << "present wait is not supported; present latency is not measured" << std::endl;
+            return;
+        }
+
+        presentMonitor.start(device, windows[0].swapChain, dispatch.waitForPresent);
+    }
+
+    // The compositor asks for a refresh when the window is exposed and the presented image was lost.
+    static void windowRefreshCallback(GLFWwindow* window) {
+        markDirty(window);
+    }
+
+    void createScene() {
+        ProfileScope scope(startupProfiler, "createScene");
+
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+        std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+
+        sceneObjects.resize(SCENE_OBJECT_COUNT);
+        for (uint32_t i = 0; i < SCENE_OBJECT_COUNT; i++) {
+            sceneObjects[i].offset[0] = offset(random);
+            sceneObjects[i].offset[1] = offset(random);
+            sceneObjects[i].scale = scale(random);
+            sceneObjects[i].depth = (i + 0.5f) / SCENE_OBJECT_COUNT;
+            sceneObjects[i].texture = i % TEXTURE_COUNT;
+            sceneObjects[i].radius = sceneObjects[i].scale * 0.5f * std::sqrt(2.0f);
+        }
+        std::shuffle(sceneObjects.begin(), sceneObjects.end(), random);
+
+        simdLevel = detectSimdLevel();
+        std::cout << "cpu simd level: " << simdLevelName(simdLevel) << std::endl;
+
+        groupCenters.assign(SCENE_GROUP_COUNT, {0.0f, 0.0f});
+        std::vector<uint32_t> groupSizes(SCENE_GROUP_COUNT, 0);
+        for (size_t i = 0; i < sceneObjects.size(); i++) {
+            groupCenters[i % SCENE_GROUP_COUNT][0] += sceneObjects[i].offset[0];
+            groupCenters[i % SCENE_GROUP_COUNT][1] += sceneObjects[i].offset[1];
+            groupSizes[i % SCENE_GROUP_COUNT]++;
+        }
+        for (uint32_t g = 0; g < SCENE_GROUP_COUNT; g++) {
+            groupCenters[g][0] /= std::max(groupSizes[g], 1u);
+            groupCenters[g][1] /= std::max(groupSizes[g], 1u);
+        }
+
+        objectTransforms.resize(sceneObjects.size());
+        for (size_t i = 0; i < sceneObjects.size(); i++) {
+            const SceneObject& object = sceneObjects[i];
+            objectTransforms.positionX[i] = object.offset[0] - groupCenters[i % SCENE_GROUP_COUNT][0];
+            objectTransforms.positionY[i] = object.offset[1] - groupCenters[i % SCENE_GROUP_COUNT][1];
+            objectTransforms.positionZ[i] = object.depth;
+            objectTransforms.rotationX[i] = 0.0f;
+            objectTransforms.rotationY[i] = 0.0f;
+            objectTransforms.rotationZ[i] = 0.0f;
+            objectTransforms.rotationW[i] = 1.0f;
+            objectTransforms.scaleX[i] = object.scale * 0.5f;
+            objectTransforms.scaleY[i] = object.scale * 0.5f;
+            objectTransforms.scaleZ[i] = -OBJECT_HALF_DEPTH;
+        }
+
+        std::vector<TransformMatrix> objectLocals(sceneObjects.size());
+        composeTransforms(simdLevel, objectTransforms, objectLocals.data()->m);
+
+        TransformMatrix identity{};
+        identity.m[0] = identity.m[5] = identity.m[10] = 1.0f;
+        uint32_t root = sceneHierarchy.addNode(NO_PARENT, identity);
+
+        objectNodes.resize(sceneObjects.size());
+        groupNodes.resize(SCENE_GROUP_COUNT);
+        for (uint32_t g = 0; g < SCENE_GROUP_COUNT; g++) {
+            TransformMatrix groupLocal = identity;
+            groupLocal.m[3] = groupCenters[g][0];
+            groupLocal.m[7] = groupCenters[g][1];
+            groupNodes[g] = sceneHierarchy.addNode(root, groupLocal);
+
+            for (uint32_t i = g; i < sceneObjects.size(); i += SCENE_GROUP_COUNT) {
+                objectNodes[i] = sceneHierarchy.addNode(groupNodes[g], objectLocals[i], i);
+            }
+        }
+
+        objectBounds.resize(sceneObjects.size());
+        for (size_t i = 0; i < sceneObjects.size(); i++) {
+            objectBounds.radius[i] = sceneObjects[i].radius;
+        }
+        sceneStartTime = std::chrono::steady_clock::now();
+
+        clipPlanes.setPlane(0, 1.0f, 0.0f, 0.0f, 1.0f);
+        clipPlanes.setPlane(1, -1.0f, 0.0f, 0.0f, 1.0f);
+        clipPlanes.setPlane(2, 0.0f, 1.0f, 0.0f, 1.0f);
+        clipPlanes.setPlane(3, 0.0f, -1.0f, 0.0f, 1.0f);
+        clipPlanes.setPlane(4, 0.0f, 0.0f, 1.0f, 0.0f);
+        clipPlanes.setPlane(5, 0.0f, 0.0f, -1.0f, 1.0f);
+
+        drawOrder.resize(sceneObjects.size());
+    }
+
+    void createObjectBuffer() {
+        ProfileScope scope(startupProfiler, "createObjectBuffer");
+
+        VkDeviceSize bufferSize = sizeof(sceneObjects[0]) * sceneObjects.size();
+        createDeviceLocalBuffer(sceneObjects.data(), bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, objectBuffer, objectBufferMemory);
+    }
+
+    void createDrawCommandBuffers() {
+        ProfileScope scope(startupProfiler, "createDrawCommandBuffers");
+
+        drawCommandBuffers.resize(frameConfig.framesInFlight);
+        drawCommandBuffersMemory.resize(frameConfig.framesInFlight);
+        drawCountBuffers.resize(frameConfig.framesInFlight);
+        drawCountBuffersMemory.resize(frameConfig.framesInFlight);
+
+        for (size_t i = 0; i < frameConfig.framesInFlight; i++) {
+            createBuffer(sizeof(VkDrawIndexedIndirectCommand) * sceneObjects.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawCommandBuffers[i], drawCommandBuffersMemory[i]);
+            createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawCountBuffers[i], drawCountBuffersMemory[i]);
+        }
+    }
+
+    void createInstanceBuffers() {
+        ProfileScope scope(startupProfiler, "createInstanceBuffers");
+
+        VkDeviceSize bufferSize = sizeof(float) * INSTANCE_TRANSFORM_FLOATS * sceneObjects.size();
+
+        instanceBuffers.resize(frameConfig.framesInFlight);
+        instanceBuffersMemory.resize(frameConfig.framesInFlight);
+        instanceBuffersMapped.resize(frameConfig.framesInFlight);
+
+        for (size_t i = 0; i < frameConfig.framesInFlight; i++) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[i], instanceBuffersMemory[i]);
+            vkMapMemory(device, instanceBuffersMemory[i], 0, bufferSize, 0, &instanceBuffersMapped[i]);
+        }
+
+        instanceWorlds.resize(sceneObjects.size());
+        pendingInstanceUploads.assign(frameConfig.framesInFlight, {});
+        instanceUploadQueued.assign(frameConfig.framesInFlight, std::vector<uint8_t>(sceneObjects.size(), 0));
+    }
+
+    // Only the animated groups are touched each frame, and the hierarchy recomputes just their subtrees. The
+    // packet carries the world matrices that changed.
+    void updateSceneTransforms(FramePacket& packet) {
+        float time = sceneTime();
+        for (uint32_t g = 0; g < ANIMATED_GROUP_COUNT; g++) {
+            float halfAngle = time * 0.25f;
+            TransformMatrix groupLocal;
+            composeTransform(groupCenters[g][0], groupCenters[g][1], 0.0f, 0.0f, 0.0f, std::sin(halfAngle), std::cos(halfAngle), 1.0f, 1.0f, 1.0f, groupLocal.m);
+            sceneHierarchy.setLocal(groupNodes[g], groupLocal);
+        }
+
+        sceneHierarchy.update(packet.changedInstances);
+
+        for (uint32_t instance : packet.changedInstances) {
+            updateObjectBounds(instance);
+            packet.changedTransforms.push_back(sceneHierarchy.getWorld(objectNodes[instance]));
+        }
+    }
+
+    // Each frame's instance buffer receives the matrices that changed since it was last written.
+    void uploadInstanceTransforms(const FramePacket& packet) {
+        for (size_t i = 0; i < packet.changedInstances.size(); i++) {
+            uint32_t instance = packet.changedInstances[i];
+            instanceWorlds[instance] = packet.changedTransforms[i];
+            for (size_t frame = 0; frame < frameConfig.framesInFlight; frame++) {
+                if (!instanceUploadQueued[frame][instance]) {
+                    instanceUploadQueued[frame][instance] = 1;
+                    pendingInstanceUploads[frame].push_back(instance);
+                }
+            }
+        }
+
+        float* mapped = static_cast<float*>(instanceBuffersMapped[currentFrame]);
+        for (uint32_t instance : pendingInstanceUploads[currentFrame]) {
+            streamTransform(instanceWorlds[instance], mapped + instance * INSTANCE_TRANSFORM_FLOATS);
+            instanceUploadQueued[currentFrame][instance] = 0;
+        }
+        finishStreamingTransforms();
+        pendingInstanceUploads[currentFrame].clear();
+    }
+
+    float sceneTime() {
+        if (options.deterministic) {
+            return simulationFrameNumber / 60.0f;
+        }
+        auto now = animationPaused ? animationPauseTime : std::chrono::steady_clock::now();
+        return std::chrono::duration<float>(now - sceneStartTime).count();
+    }
+
+    // Resuming shifts the start time by the paused interval so the animation continues where it stopped.
+    void toggleAnimation() {
+        auto now = std::chrono::steady_clock::now();
+        if (animationPaused) {
+            sceneStartTime += now - animationPauseTime;
+        } else {
+            animationPauseTime = now;
+        }
+        animationPaused = !animationPaused;
+    }
+
+    void updateObjectBounds(uint32_t instance) {
+        const TransformMatrix& world = sceneHierarchy.getWorld(objectNodes[instance]);
+        float radius = objectBounds.radius[instance];
+
+        objectBounds.centerX[instance] = world.m[3];
+        objectBounds.centerY[instance] = world.m[7];
+        objectBounds.centerZ[instance] = world.m[11];
+        objectBounds.minX[instance] = world.m[3] - radius;
+        objectBounds.minY[instance] = world.m[7] - radius;
+        objectBounds.minZ[instance] = world.m[11] - OBJECT_HALF_DEPTH;
+        objectBounds.maxX[instance] = world.m[3] + radius;
+        objectBounds.maxY[instance] = world.m[7] + radius;
+        objectBounds.maxZ[instance] = world.m[11] + OBJECT_HALF_DEPTH;
+    }
+
+    void createCaptureResources() {
+        ProfileScope scope(startupProfiler, "createCaptureResources");
+
+        const RenderWindow& renderWindow = windows[0];
+        VkFormat format = renderWindow.swapChainImageFormat;
+        captureSwizzle = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+        captureSupported = renderWindow.swapChainTransferSrc && (captureSwizzle || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM);
+        if (!captureSupported) {
+            std::cout << "frame capture is not supported by this swap chain" << std::endl;
+            return;
+        }
+
+        // Cached memory makes the CPU-side conversion read at full speed; it may not be coherent, so ranges are
+        // invalidated before reading in that case.
+        uint32_t memoryTypeIndex;
+        VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        if (tryFindMemoryType(UINT32_MAX, properties | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memoryTypeIndex)) {
+            properties |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        } else if (!tryFindMemoryType(UINT32_MAX, properties, memoryTypeIndex)) {
+            properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+        captureMemoryCoherent = (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+        VkDeviceSize bufferSize = static_cast<VkDeviceSize>(renderWindow.swapChainExtent.width) * renderWindow.swapChainExtent.height * 4;
+        captureSlots.resize(CAPTURE_RING_SIZE);
+        for (auto& slot : captureSlots) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.buffer, slot.memory);
+            vkMapMemory(device, slot.memory, 0, bufferSize, 0, &slot.mapped);
+        }
+
+        std::filesystem::create_directories(options.captureDirectory);
+        captureWriter.start(2, simdLevel, options.captureDirectory);
+    }
+
+    void cleanupCaptureResources() {
+        for (auto& slot : captureSlots) {
+            vkDestroyBuffer(device, slot.buffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+            memoryBudget.free(slot.memory);
+        }
+        captureSlots.clear();
+    }
+
+    static void keyCallback(GLFWwindow* window, int key, int, int action, int) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        recordInput(window);
+        if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+            app->captureRequested = true;
+        }
+        if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+            app->toggleAnimation();
+            markDirty(window);
+        }
+    }
+
+    // Runs right after this frame slot's fence wait, so any capture recorded in the slot's previous submission has
+    // landed in its readback buffer and can be handed to the writer without waiting on the GPU.
+    void updateCapture() {
+        auto start = std::chrono::steady_clock::now();
+        activeCaptureSlot = UINT32_MAX;
+        if (!captureSupported) return;
+
+        releasedCaptureSlots.clear();
+        captureWriter.poll(releasedCaptureSlots);
+        for (uint32_t slot : releasedCaptureSlots) {
+            captureSlots[slot].state = CaptureSlotState::Free;
+        }
+
+        for (uint32_t i = 0; i < captureSlots.size(); i++) {
+            if (captureSlots[i].state == CaptureSlotState::Recording && captureSlots[i].frame == currentFrame) {
+                submitCapture(i);
+            }
+        }
+
+        bool wanted = captureRequestPending || (CAPTURE_INTERVAL > 0 && frameNumber % CAPTURE_INTERVAL == 0) || options.captureFrames.count(frameNumber) > 0;
+        if (wanted) {
+            for (uint32_t i = 0; i < captureSlots.size(); i++) {
+                if (captureSlots[i].state != CaptureSlotState::Free) continue;
+                captureSlots[i].state = CaptureSlotState::Recording;
+                captureSlots[i].frame = currentFrame;
+                captureSlots[i].frameNumber = frameNumber;
+                activeCaptureSlot = i;
+                break;
+            }
+
+            if (activeCaptureSlot == UINT32_MAX) {
+                droppedCaptures++;
+            } else {
+                captureRequestPending = false;
+            }
+        }
+
+        captureCpuMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void submitCapture(uint32_t index) {
+        CaptureSlot& slot = captureSlots[index];
+        if (!captureMemoryCoherent) {
+            VkMappedMemoryRange range{};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = slot.memory;
+            range.size = VK_WHOLE_SIZE;
+            dispatch.invalidateMappedMemoryRanges(device, 1, &range);
+        }
+
+        VkExtent2D extent = windows[0].swapChainExtent;
+        slot.state = CaptureSlotState::Encoding;
+        captureWriter.submit({index, static_cast<const uint8_t*>(slot.mapped), extent.width, extent.height, captureSwizzle, slot.frameNumber});
+    }
+
+    // A recorded capture is only handed to the writer once its frame slot comes round again.
+    bool captureRecording() {
+        for (const auto& slot : captureSlots) {
+            if (slot.state == CaptureSlotState::Recording) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Called once the device is idle, so captures from the last frames in flight are written too.
+    void flushCaptures() {
+        for (uint32_t i = 0; i < captureSlots.size(); i++) {
+            if (captureSlots[i].state == CaptureSlotState::Recording) {
+                submitCapture(i);
+            }
+        }
+    }
+
+    void recordCapture(VkCommandBuffer commandBuffer, const RenderWindow& renderWindow) {
+        if (activeCaptureSlot == UINT32_MAX) return;
+
+        auto start = std::chrono::steady_clock::now();
+        const CaptureSlot& slot = captureSlots[activeCaptureSlot];
+
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {renderWindow.swapChainExtent.width, renderWindow.swapChainExtent.height, 1};
+        dispatch.cmdCopyImageToBuffer(commandBuffer, renderWindow.swapChainImages[renderWindow.imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = slot.buffer;
+        barrier.size = VK_WHOLE_SIZE;
+        dispatch.cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        captureCpuMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void reportCaptureStatistics() {
+        if (!captureSupported) return;
+
+        CaptureStatistics statistics = captureWriter.getStatistics();
+        uint64_t encoded = std::max<uint64_t>(statistics.written + statistics.failed, 1);
+        std::cout << "capture: " << statistics.written << " written, " << statistics.failed << " failed, " << droppedCaptures << " dropped; "
+                  << "worker " << statistics.convertMilliseconds / encoded << " ms convert + " << statistics.encodeMilliseconds / encoded << " ms encode per frame; "
+                  << "render thread " << captureCpuMilliseconds << " ms of " << frameMilliseconds << " ms ("
+                  << (frameMilliseconds > 0.0 ? 100.0 * captureCpuMilliseconds / frameMilliseconds : 0.0) << "%)" << std::endl;
+    }
+
+    void createCullPipeline() {
+        ProfileScope scope(startupProfiler, "createCullPipeline");
+
+        auto cullShaderCode = readFile("shaders/cull.spv");
+        VkShaderModule cullShaderModule = createShaderModule(cullShaderCode);
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullParameters);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        VkPipelineLayout newCullPipelineLayout;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &newCullPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create cull pipeline layout!");
+        }
+        cullPipelineLayout = DeferredHandle<VkPipelineLayout>(deletionQueue, device, newCullPipelineLayout, vkDestroyPipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = cullShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = cullPipelineLayout.get();
+
+        VkPipeline newCullPipeline;
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &newCullPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create cull pipeline!");
+        }
+        cullPipeline = DeferredHandle<VkPipeline>(deletionQueue, device, newCullPipeline, vkDestroyPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+
+        vkDestroyShaderModule(device, cullShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+
+    // Culls every object against the clip volume and compacts the survivors into this frame's indirect command
+    // buffer. Without VK_KHR_draw_indirect_count the whole buffer is drawn, so it is cleared first and the
+    // slots past the visible count stay zero-sized draws.
+    void recordCulling(VkCommandBuffer commandBuffer) {
+        VkBuffer drawCommandBuffer = drawCommandBuffers[currentFrame];
+        VkBuffer drawCountBuffer = drawCountBuffers[currentFrame];
+
+        dispatch.cmdFillBuffer(commandBuffer, drawCountBuffer, 0, sizeof(uint32_t), 0);
+        if (!drawIndirectCountSupported) {
+            dispatch.cmdFillBuffer(commandBuffer, drawCommandBuffer, 0, VK_WHOLE_SIZE, 0);
+        }
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        dispatch.cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        CullParameters parameters{static_cast<uint32_t>(sceneObjects.size()), static_cast<uint32_t>(indices.size()), OBJECT_HALF_DEPTH};
+        dispatch.cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline.get());
+        dispatch.cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout.get(), 0, 1, &cullDescriptorSets[currentFrame], 0, nullptr);
+        dispatch.cmdPushConstants(commandBuffer, cullPipelineLayout.get(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(parameters), &parameters);
+        dispatch.cmdDispatch(commandBuffer, (parameters.objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        dispatch.cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void sortDrawOrder(bool backToFront, std::vector<uint32_t>& order) {
+        order.resize(objectBounds.size());
+        order.resize(cullBoundingVolumes(simdLevel, clipPlanes, objectBounds, order.data()));
+        std::sort(order.begin(), order.end(), [this, backToFront](uint32_t a, uint32_t b) {
+            return backToFront ? sceneObjects[a].depth > sceneObjects[b].depth : sceneObjects[a].depth < sceneObjects[b].depth;
+        });
+    }
+
+    void collectGpuProfile(uint32_t frame) {
+        if (inFlightFrameNumbers[frame] == 0 || !gpuProfiler.collect(frame)) return;
+
+        const GpuScopeSample& frameSample = gpuProfiler.getSamples()[0];
+        if (gpuProfiler.timestampsSupported()) {
+            gpuBusyMilliseconds += frameSample.milliseconds;
+            updateResolutionScale(frameSample.milliseconds);
+        }
+        if (frameSample.hasStatistics) {
+            collectFragmentStatistics(frame, frameSample.fragmentInvocations);
+        }
+    }
+
+    // The last frames in flight are never waited on by drawFrame, so their results are read once the device is idle.
+    void collectGpuProfiles() {
+        for (uint32_t frame = 0; frame < frameConfig.framesInFlight; frame++) {
+            collectGpuProfile(frame);
+        }
+    }
+
+    void collectFragmentStatistics(uint32_t frame, uint64_t invocations) {
+        if (!inFlightCalibration[frame]) {
+            frontToBackInvocations = invocations;
+            return;
+        }
+
+        uint64_t saved = invocations > frontToBackInvocations ? invocations - frontToBackInvocations : 0;
+        std::cout << "fragment shader invocations: front-to-back " << frontToBackInvocations << ", back-to-front " << invocations
+                  << ", saved " << saved << " (" << (invocations > 0 ? 100.0 * saved / invocations : 0.0) << "%)" << std::endl;
+    }
+
+    void createDescriptorSetLayout() {
+        ProfileScope scope(startupProfiler, "createDescriptorSetLayout");
+
+        VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+        samplerLayoutBinding.binding = 0;
+        samplerLayoutBinding.descriptorCount = TEXTURE_COUNT;
+        samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        samplerLayoutBinding.pImmutableSamplers = nullptr;
+        samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutBinding objectLayoutBinding{};
+        objectLayoutBinding.binding = 1;
+        objectLayoutBinding.descriptorCount = 1;
+        objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+        instanceLayoutBinding.binding = 2;
+        instanceLayoutBinding.descriptorCount = 1;
+        instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings = {samplerLayoutBinding, objectLayoutBinding, instanceLayoutBinding};
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+
+        std::array<VkDescriptorSetLayoutBinding, 4> cullBindings{};
+        for (uint32_t i = 0; i < cullBindings.size(); i++) {
+            cullBindings[i].binding = i;
+            cullBindings[i].descriptorCount = 1;
+            cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        layoutInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+        layoutInfo.pBindings = cullBindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &cullDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create cull descriptor set layout!");
+        }
+    }
+
+    void createDescriptorPool() {
+        ProfileScope scope(startupProfiler, "createDescriptorPool");
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(frameConfig.framesInFlight * TEXTURE_COUNT);
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[1].descriptorCount = static_cast<uint32_t>(frameConfig.framesInFlight * 6);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = static_cast<uint32_t>(frameConfig.framesInFlight * 2);
+
+        if (vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+    }
+
+    void createDescriptorSets() {
+        ProfileScope scope(startupProfiler, "createDescriptorSets");
+
+        std::vector<VkDescriptorSetLayout> layouts(frameConfig.framesInFlight, descriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(frameConfig.framesInFlight);
+        allocInfo.pSetLayouts = layouts.data();
+
+        descriptorSets.resize(frameConfig.framesInFlight);
+        if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+
+        descriptorSetVersions.assign(frameConfig.framesInFlight, 0);
+        for (size_t i = 0; i < frameConfig.framesInFlight; i++) {
+            updateTextureDescriptors(i);
+        }
+
+        std::vector<VkDescriptorSetLayout> cullLayouts(frameConfig.framesInFlight, cullDescriptorSetLayout);
+        allocInfo.pSetLayouts = cullLayouts.data();
+
+        cullDescriptorSets.resize(frameConfig.framesInFlight);
+        if (vkAllocateDescriptorSets(device, &allocInfo, cullDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate cull descriptor sets!");
+        }
+
+        for (size_t i = 0; i < frameConfig.framesInFlight; i++) {
+            VkDescriptorBufferInfo objectInfo{objectBuffer, 0, VK_WHOLE_SIZE};
+            VkDescriptorBufferInfo commandInfo{drawCommandBuffers[i], 0, VK_WHOLE_SIZE};
+            VkDescriptorBufferInfo countInfo{drawCountBuffers[i], 0, VK_WHOLE_SIZE};
+            VkDescriptorBufferInfo instanceInfo{instanceBuffers[i], 0, VK_WHOLE_SIZE};
+
+            std::array<VkWriteDescriptorSet, 6> descriptorWrites{};
+            for (auto& descriptorWrite : descriptorWrites) {
+                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrite.descriptorCount = 1;
+            }
+
+            descriptorWrites[0].dstSet = descriptorSets[i];
+            descriptorWrites[0].dstBinding = 1;
+            descriptorWrites[0].pBufferInfo = &objectInfo;
+
+            descriptorWrites[1].dstSet = cullDescriptorSets[i];
+            descriptorWrites[1].dstBinding = 0;
+            descriptorWrites[1].pBufferInfo = &objectInfo;
+
+            descriptorWrites[2].dstSet = cullDescriptorSets[i];
+            descriptorWrites[2].dstBinding = 1;
+            descriptorWrites[2].pBufferInfo = &commandInfo;
+
+            descriptorWrites[3].dstSet = cullDescriptorSets[i];
+            descriptorWrites[3].dstBinding = 2;
+            descriptorWrites[3].pBufferInfo = &countInfo;
+
+            descriptorWrites[4].dstSet = descriptorSets[i];
+            descriptorWrites[4].dstBinding = 2;
+            descriptorWrites[4].pBufferInfo = &instanceInfo;
+
+            descriptorWrites[5].dstSet = cullDescriptorSets[i];
+            descriptorWrites[5].dstBinding = 3;
+            descriptorWrites[5].pBufferInfo = &instanceInfo;
+
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+
+    // Descriptor sets are per frame in flight, so the set for the current frame is free to rewrite once its fence has signaled.
+    void updateTextureDescriptors(size_t frame) {
+        if (descriptorSetVersions[frame] == textureVersion) return;
+
+        std::array<VkDescriptorImageInfo, TEXTURE_COUNT> imageInfos{};
+        for (uint32_t i = 0; i < TEXTURE_COUNT; i++) {
+            bool resident = textures[i].imageView != VK_NULL_HANDLE;
+            imageInfos[i].imageLayout = resident ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfos[i].imageView = resident ? textures[i].imageView : placeholderImageView;
+            imageInfos[i].sampler = textureSampler;
+        }
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSets[frame];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = TEXTURE_COUNT;
+        descriptorWrite.pImageInfo = imageInfos.data();
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+        descriptorSetVersions[frame] = textureVersion;
+    }
+
+    void createTextureStreaming() {
+        ProfileScope scope(startupProfiler, "createTextureStreaming");
+
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
+
+        if (vkCreateCommandPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &transferCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer command pool!");
+        }
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.maxAnisotropy = 1.0f;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        samplerInfo.mipLodBias = 0.0f;
+
+        if (vkCreateSampler(device, &samplerInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SAMPLER), &textureSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
+
+        createPlaceholderTexture();
+
+        textures.resize(TEXTURE_COUNT);
+        for (auto& texture : textures) {
+            texture.width = TEXTURE_SIZE;
+            texture.height = TEXTURE_SIZE;
+            texture.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texture.width, texture.height)))) + 1;
+            texture.mipData.resize(texture.mipLevels);
+            texture.loadRequested.assign(texture.mipLevels, false);
+            texture.lastUsedFrame.assign(texture.mipLevels, 0);
+            texture.desiredMip = texture.mipLevels - 1;
+            texture.residentMip = texture.mipLevels;
+        }
+
+        textureLoader.start(std::clamp(std::thread::hardware_concurrency(), 2u, 5u) - 1);
+
+        // Under memory pressure the texture budget shrinks below what is resident, so the least recently used mips
+        // are dropped. Deterministic runs keep their residency so captures do not depend on other processes.
+        if (!options.deterministic) {
+            memoryBudget.addPressureCallback([this](uint32_t heap, VkDeviceSize bytesToRelease) {
+                if (!memoryBudget.getHeapStatus(heap).deviceLocal) return;
+                if (bytesToRelease == 0) {
+                    textureBudget = TEXTURE_BUDGET;
+                    return;
+                }
+                textureBudget = std::min(textureBudget, textureResidentBytes - std::min(textureResidentBytes, bytesToRelease));
+                reserveTextureMemory(UINT32_MAX, 0);
+            });
+        }
+    }
+
+    void createPlaceholderTexture() {
+        const uint8_t pixel[4] = {128, 128, 128, 255};
+
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(sizeof(pixel), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, sizeof(pixel), 0, &data);
+        memcpy(data, pixel, sizeof(pixel));
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        createImage(1, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, placeholderImage, placeholderImageMemory);
+
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        recordTextureUpload(commandBuffer, placeholderImage, stagingBuffer, 1, 1, 1, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        endSingleTimeCommands(commandBuffer);
+
+        vkDestroyBuffer(device, stagingBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        memoryBudget.free(stagingBufferMemory);
+
+        placeholderImageView = createImageView(placeholderImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    }
+
+    void cleanupTextureStreaming() {
+        for (auto& upload : textureUploads) {
+            destroyTextureUploadStaging(upload);
+            vkDestroySemaphore(device, upload.semaphore, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+            vkDestroyImageView(device, upload.imageView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+            vkDestroyImage(device, upload.image, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+            memoryBudget.free(upload.imageMemory);
+        }
+
+        for (auto semaphore : textureUploadSemaphores) {
+            vkDestroySemaphore(device, semaphore, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+        }
+
+        for (auto& texture : textures) {
+            if (texture.image == VK_NULL_HANDLE) continue;
+            vkDestroyImageView(device, texture.imageView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+            vkDestroyImage(device, texture.image, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+            memoryBudget.free(texture.imageMemory);
+        }
+
+        vkDestroyImageView(device, placeholderImageView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+        vkDestroyImage(device, placeholderImage, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+        memoryBudget.free(placeholderImageMemory);
+
+        vkDestroySampler(device, textureSampler, hostAllocator.callbacks(VK_OBJECT_TYPE_SAMPLER));
+        vkDestroyDescriptorPool(device, descriptorPool, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+        vkDestroyCommandPool(device, transferCommandPool, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+    }
+
+    // Deterministic runs must not let captured frames depend on how fast mips arrive, so every texture is
+    // streamed to its desired residency before the first frame.
+    void waitForTextureResidency() {
+        while (true) {
+            updateTextureStreaming();
+            if (!textureStreamingBusy()) break;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    bool textureStreamingBusy() {
+        for (const auto& texture : textures) {
+            for (uint32_t mip = texture.desiredMip; mip < texture.mipLevels; mip++) {
+                if (texture.loadRequested[mip] && texture.mipData[mip].empty()) {
+                    return true;
+                }
+            }
+        }
+
+        return !textureUploads.empty();
+    }
+
+    void updateTextureStreaming() {
+        completeTextureUploads();
+
+        textureLoader.poll(loadedMips);
+        for (auto& mip : loadedMips) {
+            textures[mip.texture].mipData[mip.mipLevel] = std::move(mip.pixels);
+        }
+        loadedMips.clear();
+
+        updateTextureDemand();
+        for (uint32_t i = 0; i < TEXTURE_COUNT; i++) {
+            requestTextureResidency(i);
+        }
+        submitTextureUploads();
+
+        updateTextureDescriptors(currentFrame);
+    }
+
+    // All uploads recorded since the last call go out in one submission and share a fence, which is destroyed once
+    // the last of them has been completed.
+    void submitTextureUploads() {
+        if (!queueSubmitter.hasPending(transferQueue)) return;
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VkFence fence;
+        if (vkCreateFence(device, &fenceInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_FENCE), &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture upload fence!");
+        }
+
+        for (auto& upload : textureUploads) {
+            if (upload.fence != VK_NULL_HANDLE) continue;
+            upload.fence = fence;
+            textureUploadFenceUses[fence]++;
+        }
+
+        if (queueSubmitter.flush(transferQueue, fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit texture uploads!");
+        }
+    }
+
+    // Demand is the finest mip whose texels are not smaller than a pixel for any object using the texture.
+    void updateTextureDemand() {
+        uint32_t viewportWidth = 0;
+        for (const auto& renderWindow : windows) {
+            viewportWidth = std::max(viewportWidth, renderWindow.swapChainExtent.width);
+        }
+
+        for (auto& texture : textures) {
+            texture.desiredMip = texture.mipLevels - 1;
+        }
+
+        for (const auto& object : sceneObjects) {
+            StreamedTexture& texture = textures[object.texture];
+            float pixels = std::max(1.0f, object.scale * 0.5f * viewportWidth);
+            float mip = std::floor(std::log2(std::max(1.0f, texture.width / pixels)));
+            texture.desiredMip = std::min(texture.desiredMip, std::min(static_cast<uint32_t>(mip), texture.mipLevels - 1));
+        }
+
+        for (auto& texture : textures) {
+            for (uint32_t mip = texture.desiredMip; mip < texture.mipLevels; mip++) {
+                texture.lastUsedFrame[mip] = frameNumber;
+            }
+        }
+    }
+
+    void requestTextureResidency(uint32_t textureIndex) {
+        StreamedTexture& texture = textures[textureIndex];
+
+        for (uint32_t mip = std::min(texture.residentMip, texture.mipLevels); mip-- > texture.desiredMip;) {
+            if (texture.mipData[mip].empty() && !texture.loadRequested[mip]) {
+                textureLoader.request(textureIndex, mip, std::max(texture.width >> mip, 1u), std::max(texture.height >> mip, 1u));
+                texture.loadRequested[mip] = true;
+            }
+        }
+
+        if (texture.uploadPending) return;
+
+        // Mips from residentMip on are copied out of the current image, so only the finer ones need CPU data.
+        uint32_t baseMip = texture.residentMip;
+        while (baseMip > texture.desiredMip && !texture.mipData[baseMip - 1].empty()) {
+            baseMip--;
+        }
+
+        // The current image keeps its memory until it retires, so the whole new chain has to fit next to it.
+        while (baseMip < texture.residentMip && !reserveTextureMemory(textureIndex, textureChainBytes(texture, baseMip))) {
+            baseMip++;
+        }
+
+        if (baseMip < texture.residentMip) {
+            uploadTexture(textureIndex, baseMip);
+        }
+    }
+
+    // Evicts the least recently used finest resident mip of other textures until the request fits the budget.
+    // The mip tail of a texture is never evicted, so draws always have something better than the placeholder.
+    // Images retiring through the deletion queue still hold their memory, so the request waits until they are gone.
+    bool reserveTextureMemory(uint32_t textureIndex, VkDeviceSize bytes) {
+        while (textureResidentBytes + bytes > textureBudget) {
+            int64_t victim = -1;
+            for (uint32_t i = 0; i < TEXTURE_COUNT; i++) {
+                const StreamedTexture& texture = textures[i];
+                if (i == textureIndex || texture.uploadPending || texture.residentMip + 1 >= texture.mipLevels) continue;
+                if (texture.lastUsedFrame[texture.residentMip] >= frameNumber) continue;
+                if (victim < 0 || texture.lastUsedFrame[texture.residentMip] < textures[victim].lastUsedFrame[textures[victim].residentMip]) {
+                    victim = i;
+                }
+            }
+
+            if (victim < 0) return false;
+            uploadTexture(static_cast<uint32_t>(victim), textures[victim].residentMip + 1);
+        }
+
+        return textureResidentBytes + textureRetiringBytes + bytes <= textureBudget;
+    }
+
+    VkDeviceSize textureChainBytes(const StreamedTexture& texture, uint32_t baseMip) {
+        VkDeviceSize bytes = 0;
+        for (uint32_t mip = baseMip; mip < texture.mipLevels; mip++) {
+            bytes += static_cast<VkDeviceSize>(std::max(texture.width >> mip, 1u)) * std::max(texture.height >> mip, 1u) * 4;
+        }
+        return bytes;
+    }
+
+    // Builds a new image holding mips baseMip.. of the texture and fills it on the transfer queue. Mips the current
+    // image already holds are copied on the GPU, so evictions and upgrades never re-upload them from CPU copies.
+    // The current image stays bound until the upload's fence signals, so draws never wait on it.
+    void uploadTexture(uint32_t textureIndex, uint32_t baseMip) {
+        StreamedTexture& texture = textures[textureIndex];
+        uint32_t levels = texture.mipLevels - baseMip;
+        uint32_t width = std::max(texture.width >> baseMip, 1u);
+        uint32_t height = std::max(texture.height >> baseMip, 1u);
+        VkDeviceSize bytes = textureChainBytes(texture, baseMip);
+        uint32_t copiedMip = texture.image != VK_NULL_HANDLE ? std::max(baseMip, texture.residentMip) : texture.mipLevels;
+        VkDeviceSize stagedBytes = bytes - textureChainBytes(texture, copiedMip);
+
+        TextureUpload upload{};
+        upload.texture = textureIndex;
+        upload.baseMip = baseMip;
+        upload.replacedBytes = texture.residentBytes;
+
+        if (stagedBytes > 0) {
+            createBuffer(stagedBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, upload.stagingBuffer, upload.stagingBufferMemory);
+
+            void* data;
+            vkMapMemory(device, upload.stagingBufferMemory, 0, stagedBytes, 0, &data);
+            VkDeviceSize offset = 0;
+            for (uint32_t mip = baseMip; mip < copiedMip; mip++) {
+                memcpy(static_cast<char*>(data) + offset, texture.mipData[mip].data(), texture.mipData[mip].size());
+                offset += texture.mipData[mip].size();
+            }
+            vkUnmapMemory(device, upload.stagingBufferMemory);
+        }
+
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.transferFamily.value()};
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = levels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        if (queueFamilyIndices[0] != queueFamilyIndices[1]) {
+            imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            imageInfo.queueFamilyIndexCount = 2;
+            imageInfo.pQueueFamilyIndices = queueFamilyIndices;
+        } else {
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
+
+        if (vkCreateImage(device, &imageInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE), &upload.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, upload.image, &memRequirements);
+        upload.imageMemory = allocateImageMemory(memRequirements, imageInfo.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkBindImageMemory(device, upload.image, upload.imageMemory, 0);
+
+        upload.imageView = createImageView(upload.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = transferCommandPool;
+        allocInfo.commandBufferCount = 1;
+        vkAllocateCommandBuffers(device, &allocInfo, &upload.commandBuffer);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(upload.commandBuffer, &beginInfo);
+        recordStreamedUpload(upload, texture, copiedMip);
+        vkEndCommandBuffer(upload.commandBuffer);
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &upload.semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture upload semaphore!");
+        }
+
+        // Submitted with the rest of the frame's uploads by submitTextureUploads.
+        queueSubmitter.begin(transferQueue);
+        queueSubmitter.addCommandBuffer(upload.commandBuffer);
+        queueSubmitter.signal(upload.semaphore, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT);
+
+        textureResidentBytes = textureResidentBytes - texture.residentBytes + bytes;
+        textureRetiringBytes += texture.residentBytes;
+        texture.residentBytes = bytes;
+        texture.uploadPending = true;
+        textureUploads.push_back(upload);
+    }
+
+    // Streamed images stay in the general layout, so the graphics queue can keep sampling the current image while
+    // the transfer queue copies its mips into the replacement.
+    void recordStreamedUpload(const TextureUpload& upload, const StreamedTexture& texture, uint32_t copiedMip) {
+        uint32_t levels = texture.mipLevels - upload.baseMip;
+
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        for (auto& barrier : barriers) {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        }
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[0].image = upload.image;
+        barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        // Orders the copy after the earlier upload that filled the current image.
+        bool copies = copiedMip < texture.mipLevels;
+        if (copies) {
+            barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barriers[1].image = texture.image;
+            barriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, copiedMip - texture.residentMip, texture.mipLevels - copiedMip, 0, 1};
+            barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        }
+        vkCmdPipelineBarrier(upload.commandBuffer, copies ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, copies ? 2 : 1, barriers.data());
+
+        if (upload.stagingBuffer != VK_NULL_HANDLE) {
+            std::vector<VkBufferImageCopy> regions;
+            VkDeviceSize offset = 0;
+            for (uint32_t mip = upload.baseMip; mip < copiedMip; mip++) {
+                uint32_t mipWidth = std::max(texture.width >> mip, 1u);
+                uint32_t mipHeight = std::max(texture.height >> mip, 1u);
+
+                VkBufferImageCopy region{};
+                region.bufferOffset = offset;
+                region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - upload.baseMip, 0, 1};
+                region.imageExtent = {mipWidth, mipHeight, 1};
+                regions.push_back(region);
+                offset += static_cast<VkDeviceSize>(mipWidth) * mipHeight * 4;
+            }
+            vkCmdCopyBufferToImage(upload.commandBuffer, upload.stagingBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+        }
+
+        if (copies) {
+            std::vector<VkImageCopy> regions;
+            for (uint32_t mip = copiedMip; mip < texture.mipLevels; mip++) {
+                VkImageCopy region{};
+                region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - texture.residentMip, 0, 1};
+                region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - upload.baseMip, 0, 1};
+                region.extent = {std::max(texture.width >> mip, 1u), std::max(texture.height >> mip, 1u), 1};
+                regions.push_back(region);
+            }
+            vkCmdCopyImage(upload.commandBuffer, texture.image, VK_IMAGE_LAYOUT_GENERAL, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+        }
+
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[0].dstAccessMask = 0;
+        vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, barriers.data());
+    }
+
+    void recordTextureUpload(VkCommandBuffer commandBuffer, VkImage image, VkBuffer buffer, uint32_t width, uint32_t height, uint32_t levels, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        std::vector<VkBufferImageCopy> regions(levels);
+        VkDeviceSize offset = 0;
+        for (uint32_t level = 0; level < levels; level++) {
+            uint32_t levelWidth = std::max(width >> level, 1u);
+            uint32_t levelHeight = std::max(height >> level, 1u);
+
+            regions[level].bufferOffset = offset;
+            regions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+            regions[level].imageOffset = {0, 0, 0};
+            regions[level].imageExtent = {levelWidth, levelHeight, 1};
+            offset += static_cast<VkDeviceSize>(levelWidth) * levelHeight * 4;
+        }
+        vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levels, regions.data());
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // Swaps in textures whose uploads have finished. The next submission waits on the upload semaphore, and the
+    // replaced image is retired through the deletion queue once the frames that may still sample it complete.
+    void completeTextureUploads() {
+        for (size_t i = 0; i < textureUploads.size();) {
+            TextureUpload& upload = textureUploads[i];
+            if (upload.fence == VK_NULL_HANDLE || dispatch.getFenceStatus(device, upload.fence) != VK_SUCCESS) {
+                i++;
+                continue;
+            }
+
+            StreamedTexture& texture = textures[upload.texture];
+            if (texture.image != VK_NULL_HANDLE) {
+                VkDevice device = this->device;
+                HostAllocator* hostAllocator = &this->hostAllocator;
+                DeviceMemoryBudget* memoryBudget = &this->memoryBudget;
+                VkImage image = texture.image;
+                VkDeviceMemory imageMemory = texture.imageMemory;
+                VkImageView imageView = texture.imageView;
+                VkDeviceSize* retiringBytes = &textureRetiringBytes;
+                VkDeviceSize replacedBytes = upload.replacedBytes;
+                deletionQueue.push([device, hostAllocator, memoryBudget, image, imageMemory, imageView, retiringBytes, replacedBytes]() {
+                    vkDestroyImageView(device, imageView, hostAllocator->callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+                    vkDestroyImage(device, image, hostAllocator->callbacks(VK_OBJECT_TYPE_IMAGE));
+                    memoryBudget->free(imageMemory);
+                    *retiringBytes -= replacedBytes;
+                });
+            }
+
+            // Resident mips are copied out of the image from now on; the loader regenerates them if they are evicted.
+            for (uint32_t mip = upload.baseMip; mip < texture.mipLevels; mip++) {
+                std::vector<uint8_t>().swap(texture.mipData[mip]);
+                texture.loadRequested[mip] = false;
+            }
+
+            texture.image = upload.image;
+            texture.imageMemory = upload.imageMemory;
+            texture.imageView = upload.imageView;
+            texture.residentMip = upload.baseMip;
+            texture.uploadPending = false;
+
+            destroyTextureUploadStaging(upload);
+            textureUploadSemaphores.push_back(upload.semaphore);
+            textureVersion++;
+
+            textureUploads.erase(textureUploads.begin() + i);
+        }
+    }
+
+    void destroyTextureUploadStaging(TextureUpload& upload) {
+        auto fenceUses = textureUploadFenceUses.find(upload.fence);
+        if (fenceUses != textureUploadFenceUses.end() && --fenceUses->second == 0) {
+            vkDestroyFence(device, upload.fence, hostAllocator.callbacks(VK_OBJECT_TYPE_FENCE));
+            textureUploadFenceUses.erase(fenceUses);
+        }
+        vkFreeCommandBuffers(device, transferCommandPool, 1, &upload.commandBuffer);
+        if (upload.stagingBuffer == VK_NULL_HANDLE) return;
+        vkDestroyBuffer(device, upload.stagingBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        memoryBudget.free(upload.stagingBufferMemory);
+    }
+
+    // Runs on the render thread and only reads simulation state through the packet.
+    void drawFrame(FramePacket& packet) {
+        dispatch.waitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        deletionQueue.flush(inFlightFrameNumbers[currentFrame]);
+        collectGpuProfile(currentFrame);
+
+        frameNumber = packet.frameNumber;
+        inFlightFrameNumbers[currentFrame] = frameNumber;
+        inFlightCalibration[currentFrame] = packet.calibration;
+        captureRequestPending = captureRequestPending || packet.captureRequested;
+        drawOrder.swap(packet.drawOrder);
+        deletionQueue.setCurrentFrame(frameNumber);
+        updateCapture();
+
+        uploadInstanceTransforms(packet);
+        memoryBudget.update();
+        updateTextureStreaming();
+
+        dispatch.resetFences(device, 1, &inFlightFences[currentFrame]);
+
+        std::vector<VkSwapchainKHR> swapChains;
+        std::vector<uint32_t> imageIndices;
+
+        for (auto& renderWindow : windows) {
+            dispatch.acquireNextImage(device, renderWindow.swapChain, UINT64_MAX, renderWindow.imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &renderWindow.imageIndex);
+
+            swapChains.push_back(renderWindow.swapChain);
+            imageIndices.push_back(renderWindow.imageIndex);
+        }
+
+        buildRenderGraph();
+        if (renderGraph.compile()) {
+            for (auto& renderWindow : windows) {
+                retireFramebuffers(renderWindow);
+                createWindowFramebuffers(renderWindow);
+            }
+        }
+
+        // Each swap chain image is waited on where the graph first touches it, which is the upscale blit rather
+        // than the color attachment output with dynamic resolution.
+        queueSubmitter.begin(graphicsQueue);
+        for (auto& renderWindow : windows) {
+            queueSubmitter.wait(renderWindow.imageAvailableSemaphores[currentFrame], renderGraph.getFirstAccessStages(renderWindow.swapChainResource));
+        }
+
+        for (VkSemaphore semaphore : textureUploadSemaphores) {
+            queueSubmitter.wait(semaphore, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+
+            VkDevice device = this->device;
+            HostAllocator* hostAllocator = &this->hostAllocator;
+            deletionQueue.push([device, hostAllocator, semaphore]() {
+                vkDestroySemaphore(device, semaphore, hostAllocator->callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+            });
+        }
+        textureUploadSemaphores.clear();
+
+        dispatch.resetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
+        recordCommandBuffer(commandBuffers[currentFrame]);
+
+        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+        queueSubmitter.addCommandBuffer(commandBuffers[currentFrame]);
+        queueSubmitter.signal(renderFinishedSemaphores[currentFrame], VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+
+        if (queueSubmitter.flush(graphicsQueue, inFlightFences[currentFrame]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = signalSemaphores;
+
+        // Every swap chain gets the frame number as its present id; ids only have to increase per swap chain.
+        std::vector<uint64_t> presentIds(swapChains.size(), frameNumber);
+        VkPresentIdKHR presentId{};
+        presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentId.swapchainCount = static_cast<uint32_t>(presentIds.size());
+        presentId.pPresentIds = presentIds.data();
+        presentInfo.pNext = presentWaitSupported ? &presentId : nullptr;
+
+        std::vector<VkResult> presentResults(swapChains.size());
+        presentInfo.swapchainCount = static_cast<uint32_t>(swapChains.size());
+        presentInfo.pSwapchains = swapChains.data();
+        presentInfo.pImageIndices = imageIndices.data();
+        presentInfo.pResults = presentResults.data();
+
+        dispatch.queuePresent(presentQueue, &presentInfo);
+
+        for (VkResult result : presentResults) {
+            if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("failed to present swap chain image!");
+            }
+        }
+
+        if (presentWaitSupported) {
+            presentMonitor.submit({frameNumber, packet.frameStart, packet.inputTime, packet.hasInput});
+        }
+
+        queueSubmitter.endFrame();
+        currentFrame = (currentFrame + 1) % frameConfig.framesInFlight;
+    }
+
+    VkShaderModule createShaderModule(const std::vector<char>& code) {
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = code.size();
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE), &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module!");
+        }
+
+        return shaderModule;
+    }
+
+    VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
+        for (const auto& availableFormat : availableFormats) {
+            if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+                return availableFormat;
+            }
+        }
+
+        return availableFormats[0];
+    }
+
+    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+        for (const auto& availablePresentMode : availablePresentModes) {
+            if (availablePresentMode == frameConfig.presentMode) {
+                return availablePresentMode;
+            }
+        }
+
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+
+    VkExtent2D chooseSwapExtent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities) {
+        if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+            return capabilities.currentExtent;
+        } else {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+
+            VkExtent2D actualExtent = {
+                static_cast<uint32_t>(width),
+                static_cast<uint32_t>(height)
+            };
+
+            actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+            actualExtent.height = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+
+            return actualExtent;
+        }
+    }
+
+    SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
+        SwapChainSupportDetails details;
+
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+
+        uint32_t formatCount;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+
+        if (formatCount != 0) {
+            details.formats.resize(formatCount);
+            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
+        }
+
+        uint32_t presentModeCount;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+
+        if (presentModeCount != 0) {
+            details.presentModes.resize(presentModeCount);
+            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+        }
+
+        return details;
+    }
+
+    bool isDeviceSuitable(VkPhysicalDevice device) {
+        QueueFamilyIndices indices = findQueueFamilies(device);
+
+        bool extensionsSupported = checkDeviceExtensionSupport(device);
+
+        bool swapChainAdequate = false;
+        if (extensionsSupported) {
+            swapChainAdequate = true;
+            for (const auto& renderWindow : windows) {
+                SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, renderWindow.surface);
+                swapChainAdequate = swapChainAdequate && !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+            }
+        }
+
+        // The fragment shader indexes the streamed texture array with a per-instance index.
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+
+        return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+    }
+
+    bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+
+        for (const auto& extension : availableExtensions) {
+            requiredExtensions.erase(extension.extensionName);
+        }
+
+        return requiredExtensions.empty();
+    }
+
+    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
+        QueueFamilyIndices indices;
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+        int i = 0;
+        for (const auto& queueFamily : queueFamilies) {
+            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                indices.graphicsFamily = i;
+            }
+
+            VkBool32 presentSupport = true;
+            for (const auto& renderWindow : windows) {
+                VkBool32 surfaceSupport = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, renderWindow.surface, &surfaceSupport);
+                presentSupport = presentSupport && surfaceSupport;
+            }
+
+            if (presentSupport) {
+                indices.presentFamily = i;
+            }
+
+            if (indices.isComplete()) {
+                break;
+            }
+
+            i++;
+        }
+
+        for (uint32_t j = 0; j < queueFamilyCount; j++) {
+            if ((queueFamilies[j].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.transferFamily = j;
+                break;
+            }
+        }
+
+        if (!indices.transferFamily.has_value()) {
+            indices.transferFamily = indices.graphicsFamily;
+        }
+
+        return indices;
+    }
+
+    std::vector<const char*> getRequiredExtensions() {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+        if (enableValidationLayers) {
+            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        }
+
+        return extensions;
+    }
+
+    bool checkValidationLayerSupport() {
+        ProfileScope scope(startupProfiler, "checkValidationLayerSupport");
+
+        uint32_t layerCount;
+        vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+
+        std::vector<VkLayerProperties> availableLayers(layerCount);
+        vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+
+        for (const char* layerName : validationLayers) {
+            bool layerFound = false;
+
+            for (const auto& layerProperties : availableLayers) {
+                if (strcmp(layerName, layerProperties.layerName) == 0) {
+                    layerFound = true;
+                    break;
+                }
+            }
+
+            if (!layerFound) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static std::vector<char> readFile(const std::string& filename) {
+        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file!");
+        }
+
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<char> buffer(fileSize);
+
+        file.seekg(0);
+        file.read(buffer.data(), fileSize);
+
+        file.close();
+
+        return buffer;
+    }
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
+        std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+
+        return VK_FALSE;
+    }
+};
+
+// Tunes one setting at a time, starting from the configured ones: every candidate value runs a short deterministic
+// benchmark, and the value with the lowest mean frame time is kept before moving on to the next setting.
+FrameConfig autoTuneFrameConfig(const RunOptions& options) {
+    RunOptions trialOptions;
+    trialOptions.deterministic = true;
+    trialOptions.frameLimit = AUTO_TUNE_FRAMES;
+
+    auto measure = [&trialOptions](const FrameConfig& config, FrameConfig& used) {
+        trialOptions.frameConfig = config;
+        HelloTriangleApplication app;
+        app.run(trialOptions);
+        used = app.getFrameConfig();
+        std::cout << "auto-tune: " << used.describe() << ": " << app.getMeanFrameMilliseconds() << " ms" << std::endl;
+        return app.getMeanFrameMilliseconds();
+    };
+
+    FrameConfig best;
+    double bestMilliseconds = measure(options.frameConfig, best);
+
+    std::vector<std::function<std::vector<FrameConfig>(const FrameConfig&)>> sweeps = {
+        [](const FrameConfig& base) {
+            std::vector<FrameConfig> candidates;
+            for (const auto& [mode, name] : PRESENT_MODE_NAMES) {
+                candidates.push_back(base);
+                candidates.back().presentMode = mode;
+            }
+            return candidates;
+        },
+        [](const FrameConfig& base) {
+            std::vector<FrameConfig> candidates;
+            for (uint32_t count = 1; count <= MAX_FRAMES_IN_FLIGHT; count++) {
+                candidates.push_back(base);
+                candidates.back().framesInFlight = count;
+            }
+            return candidates;
+        },
+        [](const FrameConfig& base) {
+            std::vector<FrameConfig> candidates;
+            for (uint32_t count = 0; count <= 2; count++) {
+                candidates.push_back(base);
+                candidates.back().extraSwapChainImages = count;
+            }
+            return candidates;
+        },
+        [](const FrameConfig& base) {
+            std::vector<FrameConfig> candidates(2, base);
+            candidates[0].gpuDrivenRendering = true;
+            candidates[1].gpuDrivenRendering = false;
+            return candidates;
+        }
+    };
+
+    // Candidates the device cannot honor fall back to a configuration that was measured already.
+    std::vector<FrameConfig> measured = {best};
+    for (const auto& sweep : sweeps) {
+        for (const FrameConfig& candidate : sweep(best)) {
+            if (std::find(measured.begin(), measured.end(), candidate) != measured.end()) continue;
+
+            FrameConfig used;
+            double milliseconds = measure(candidate, used);
+            measured.push_back(candidate);
+            measured.push_back(used);
+            if (milliseconds > 0.0 && milliseconds < bestMilliseconds) {
+                best = used;
+                bestMilliseconds = milliseconds;
+            }
+        }
+    }
+
+    std::cout << "auto-tune: fastest is " << best.describe() << " at " << bestMilliseconds << " ms per frame" << std::endl;
+    return best;
+}
+
+void runRenderer(int argc, char* argv[]) {
+    RunOptions options = parseRunOptions(argc, argv);
+    if (options.autoTune) {
+        saveFrameConfig(options.configPath, autoTuneFrameConfig(options));
+        std::cout << "saved frame settings to " << options.configPath << std::endl;
+        return;
+    }
+
+    HelloTriangleApplication app;
+    app.run(options);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// The Vulkan renderer is built into librenderer_core.a with the CPU kernels, so LTO and PGO cover the frame loop as
+// well; VulkanTest's main() only reports the errors.
+
+// Parses the command line (see parseRunOptions), then either auto-tunes and saves the frame settings or runs the
+// renderer until its window closes or its frame limit is reached. Failures are thrown as std::runtime_error.
+void runRenderer(int argc, char* argv[]);
@@ -1,9 +1,14 @@
 #version 450
 
-layout(location = 0) in vec3 fragColor;
+layout(binding = 0) uniform sampler2D textures[4];
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTexture;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    float diffuse = max(dot(normalize(fragNormal), normalize(vec3(0.4, -0.6, 0.7))), 0.0);
+    outColor = vec4(texture(textures[fragTexture], fragTexCoord).rgb * (0.25 + 0.75 * diffuse), 1.0);
 }
\ No newline at end of file
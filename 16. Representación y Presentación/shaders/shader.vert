@@ -1,20 +1,50 @@
 #version 450
 
-layout(location = 0) out vec3 fragColor;
+struct SceneObject {
+    vec2 offset;
+    float scale;
+    float depth;
+    uint texture;
+    float radius;
+};
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+layout(std430, binding = 1) readonly buffer SceneObjects {
+    SceneObject objects[];
+};
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+struct InstanceTransform {
+    vec4 rows[3];
+};
+
+layout(std430, binding = 2) readonly buffer InstanceTransforms {
+    InstanceTransform transforms[];
+};
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTexture;
+
+vec3 octahedralDecode(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (normal.z < 0.0) {
+        normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(normal);
+}
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    SceneObject object = objects[gl_InstanceIndex];
+    InstanceTransform transform = transforms[gl_InstanceIndex];
+    vec4 position = vec4(inPosition.xyz, 1.0);
+    gl_Position = vec4(dot(transform.rows[0], position), dot(transform.rows[1], position), dot(transform.rows[2], position), 1.0);
+
+    vec3 axisX = normalize(vec3(transform.rows[0].x, transform.rows[1].x, transform.rows[2].x));
+    vec3 axisY = normalize(vec3(transform.rows[0].y, transform.rows[1].y, transform.rows[2].y));
+    fragNormal = mat3(axisX, axisY, cross(axisX, axisY)) * octahedralDecode(inNormal);
+    fragTexCoord = inTexCoord;
+    fragTexture = object.texture;
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "transforms.h"
+
+static void composeTransformScalar(const InstanceTransforms& transforms, size_t i, float* matrix) {
+    composeTransform(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i],
+        transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i], transforms.rotationW[i],
+        transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i], matrix);
+}
+
+static void composeTransformsScalar(const InstanceTransforms& transforms, size_t begin, size_t end, float* matrices) {
+    for (size_t i = begin; i < end; i++) {
+        composeTransformScalar(transforms, i, matrices + i * INSTANCE_TRANSFORM_FLOATS);
+    }
+}
+
+#if defined(SIMD_X86)
+// Transposes four 8-wide matrix elements into one 4-float row per instance and stores each row. The matrices
+// land in cached memory that is read again right away, so these are plain stores rather than streaming ones.
+static SIMD_TARGET_AVX2 void storeRows(__m256 e0, __m256 e1, __m256 e2, __m256 e3, size_t row, float* matrices) {
+    __m256 t0 = _mm256_unpacklo_ps(e0, e1);
+    __m256 t1 = _mm256_unpackhi_ps(e0, e1);
+    __m256 t2 = _mm256_unpacklo_ps(e2, e3);
+    __m256 t3 = _mm256_unpackhi_ps(e2, e3);
+
+    __m256 instances[4] = {
+        _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+        _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+        _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+        _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2))
+    };
+
+    for (size_t i = 0; i < 4; i++) {
+        _mm_storeu_ps(matrices + i * INSTANCE_TRANSFORM_FLOATS + row * 4, _mm256_castps256_ps128(instances[i]));
+        _mm_storeu_ps(matrices + (i + 4) * INSTANCE_TRANSFORM_FLOATS + row * 4, _mm256_extractf128_ps(instances[i], 1));
+    }
+}
+
+static SIMD_TARGET_AVX2 void composeTransformsAVX2(const InstanceTransforms& transforms, float* matrices) {
+    size_t end = transforms.size() & ~size_t(7);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    for (size_t i = 0; i < end; i += 8) {
+        __m256 x = _mm256_loadu_ps(&transforms.rotationX[i]);
+        __m256 y = _mm256_loadu_ps(&transforms.rotationY[i]);
+        __m256 z = _mm256_loadu_ps(&transforms.rotationZ[i]);
+        __m256 w = _mm256_loadu_ps(&transforms.rotationW[i]);
+        __m256 sx = _mm256_loadu_ps(&transforms.scaleX[i]);
+        __m256 sy = _mm256_loadu_ps(&transforms.scaleY[i]);
+        __m256 sz = _mm256_loadu_ps(&transforms.scaleZ[i]);
+
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        float* block = matrices + i * INSTANCE_TRANSFORM_FLOATS;
+        storeRows(
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx),
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy),
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz),
+            _mm256_loadu_ps(&transforms.positionX[i]), 0, block);
+        storeRows(
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx),
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy),
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz),
+            _mm256_loadu_ps(&transforms.positionY[i]), 1, block);
+        storeRows(
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx),
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy),
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz),
+            _mm256_loadu_ps(&transforms.positionZ[i]), 2, block);
+    }
+
+    composeTransformsScalar(transforms, end, transforms.size(), matrices);
+}
+#endif
+
+void composeTransforms(SimdLevel level, const InstanceTransforms& transforms, float* matrices) {
+#if defined(SIMD_X86)
+    if (level == SimdLevel::AVX2) {
+        composeTransformsAVX2(transforms, matrices);
+        return;
+    }
+#endif
+    composeTransformsScalar(transforms, 0, transforms.size(), matrices);
+}
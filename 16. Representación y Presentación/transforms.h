@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "cpu_features.h"
+
+// One row-major 3x4 matrix per instance, laid out as three vec4 rows to match std430 in the vertex shader.
+const size_t INSTANCE_TRANSFORM_FLOATS = 12;
+
+struct InstanceTransforms {
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+
+    void resize(size_t count) {
+        for (std::vector<float>* column : {&positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY, &scaleZ}) {
+            column->resize(count);
+        }
+    }
+
+    size_t size() const {
+        return positionX.size();
+    }
+};
+
+struct alignas(16) TransformMatrix {
+    float m[INSTANCE_TRANSFORM_FLOATS];
+};
+
+inline void composeTransform(float px, float py, float pz, float x, float y, float z, float w, float sx, float sy, float sz, float* matrix) {
+    matrix[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+    matrix[1] = 2.0f * (x * y - w * z) * sy;
+    matrix[2] = 2.0f * (x * z + w * y) * sz;
+    matrix[3] = px;
+    matrix[4] = 2.0f * (x * y + w * z) * sx;
+    matrix[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+    matrix[6] = 2.0f * (y * z - w * x) * sz;
+    matrix[7] = py;
+    matrix[8] = 2.0f * (x * z - w * y) * sx;
+    matrix[9] = 2.0f * (y * z + w * x) * sy;
+    matrix[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+    matrix[11] = pz;
+}
+
+// Affine product a * b, treating both as 4x4 matrices with an implicit (0, 0, 0, 1) last row.
+inline TransformMatrix multiplyTransforms(const TransformMatrix& a, const TransformMatrix& b) {
+    TransformMatrix result;
+    for (size_t row = 0; row < 3; row++) {
+        const float* r = a.m + row * 4;
+        for (size_t column = 0; column < 4; column++) {
+            result.m[row * 4 + column] = r[0] * b.m[column] + r[1] * b.m[4 + column] + r[2] * b.m[8 + column];
+        }
+        result.m[row * 4 + 3] += r[3];
+    }
+    return result;
+}
+
+// Writes one 3x4 matrix per instance into matrices, an array of INSTANCE_TRANSFORM_FLOATS floats per instance.
+// Used to build the scene's local matrices at startup; per-frame uploads copy hierarchy results with streamTransform.
+void composeTransforms(SimdLevel level, const InstanceTransforms& transforms, float* matrices);
+
+// Copies a single matrix into mapped memory, bypassing the cache where streaming stores are available. Callers
+// batch several copies and finish with finishStreamingTransforms().
+inline void streamTransform(const TransformMatrix& matrix, float* destination) {
+#if defined(SIMD_X86)
+    _mm_stream_ps(destination, _mm_load_ps(matrix.m));
+    _mm_stream_ps(destination + 4, _mm_load_ps(matrix.m + 4));
+    _mm_stream_ps(destination + 8, _mm_load_ps(matrix.m + 8));
+#else
+    std::copy(matrix.m, matrix.m + INSTANCE_TRANSFORM_FLOATS, destination);
+#endif
+}
+
+inline void finishStreamingTransforms() {
+#if defined(SIMD_X86)
+    _mm_sfence();
+#endif
+}
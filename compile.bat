@@ -2,4 +2,5 @@
 set VULKAN_SDK=C:\VulkanSDK\VERSION\Bin
 "%VULKAN_SDK%\glslc.exe" shader.vert -o vert.spv
 "%VULKAN_SDK%\glslc.exe" shader.frag -o frag.spv
+"%VULKAN_SDK%\glslc.exe" cull.comp -o cull.spv
 pause
\ No newline at end of file
@@ -3,9 +3,11 @@
 ## Linux ##
 /home/user/VulkanSDK/x.x.x.x/x86_64/bin/glslc shader.vert -o shaders/vert.spv
 /home/user/VulkanSDK/x.x.x.x/x86_64/bin/glslc shader.frag -o shaders/frag.spv
+/home/user/VulkanSDK/x.x.x.x/x86_64/bin/glslc cull.comp -o shaders/cull.spv
 
 ## MacOS ##
 # VULKAN_SDK=/path/to/vulkan-sdk/bin
 # "$VULKAN_SDK/glslc" shader.vert -o shaders/vert.spv
 # "$VULKAN_SDK/glslc" shader.frag -o shaders/frag.spv
+# "$VULKAN_SDK/glslc" cull.comp -o shaders/cull.spv
 